@@ -0,0 +1,235 @@
+#include <vector>
+#include <valarray>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <memory>
+#include <climits>
+#include <cmath>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "planner.h"
+#include "scheduler.h"
+#include "lazy.h"
+#include "chunked.h"
+#include "budget.h"
+#include "instrument.h"
+
+namespace {
+
+const char *execution_names[] = {"full grid", "observation schedule", "chunked", "streaming", "out of core"};
+
+/** \brief      Paths of one Block_stream block, with their variates, per worker.
+*/
+std::size_t worker_bytes(const Run_request &r) {
+    return static_cast<std::size_t>(r.num_workers) * Block_stream::paths_per_block * 2 * sizeof(double);
+}
+
+/** \brief      Steps every path of one scheme in Block_stream blocks up to the last stored step,
+*               keeping the stored steps in slices when there are any, and returns the statistics
+*               of the last one.
+*/
+Running_stats run_blocks(const std::string &scheme, const Parameters &p, long N, int ts,
+                         const std::vector<int> &stored, std::vector<std::valarray<double>> *slices,
+                         std::uint64_t seed, Scheduler &scheduler) {
+
+    Step_function step = scheme_step(scheme);
+    Step_table table{p, ts};
+    double delta_t = (p.T - p.t0) / ts;
+
+    auto paths = [&](long first, int n, auto draw, Running_stats &st) {
+        std::valarray<double> prices(p.S0, n);
+        std::valarray<double> rans(n);
+        std::size_t next_stored = 0;
+
+        for (int k = 1; k <= stored.back(); ++k) {
+            draw(&rans[0], n);
+            step(prices, rans, table[k - 1], delta_t);
+            if (stored[next_stored] == k) {
+                if (slices) {
+                    (*slices)[next_stored][std::slice(first, n, 1)] = prices;
+                }
+                ++next_stored;
+            }
+        }
+        st.add(prices);
+    };
+    return parallel_blocks<Running_stats>(scheduler, N, seed, paths);
+}
+
+} // namespace
+
+/** \brief 		Estimates the peak memory and the time of every execution of a request, and picks
+*				the fastest that fits in the budget. Full grid and observation schedule execution
+*				are serial; chunked and streaming execution share the paths over num_workers.
+*   \param 		request - The schemes, N, ts and the outputs needed.
+*   \param      budget - The bytes the run may use.
+*   \param      model - The per-item costs.
+*   \return		Budget_plan . Every estimate and the chosen execution. Exits when none fits.
+*
+*/
+Budget_plan plan_for_budget(const Run_request &request, std::size_t budget, const Cost_model &model) {
+
+    // The stored steps do not depend on the parameters, only on the outputs needed.
+    std::vector<int> stored = plan_exact(Parameters{}, request.num_timesteps, request.need,
+                                         request.observation_steps).stored_steps;
+
+    const double S = request.schemes.size();
+    const double N = request.num_sims;
+    const double k = stored.size();
+    const double W = std::max(1, request.num_workers);
+    const int ts = request.num_timesteps;
+    const double horizon = stored.back();
+    const std::size_t value = sizeof(double);
+    const std::size_t pool = static_cast<std::size_t>(request.num_sims) * ts * value;
+
+    std::string no_pool;
+    if (N * ts > INT_MAX) {
+        no_pool = "needs a pool of more than 2^31 variates";
+    }
+
+    Budget_plan plan{request, budget, stored, {}, Execution::full_grid};
+    auto add = [&plan](Execution e, double bytes, double ns, std::string unavailable) {
+        plan.estimates.push_back(Execution_estimate{e, static_cast<std::size_t>(bytes), ns * 1e-9,
+                                                    std::move(unavailable)});
+    };
+
+    add(Execution::full_grid, pool + S * N * (ts + 1) * value,
+        N * ts * (model.variate_ns + S * (model.step_ns + model.store_ns)), no_pool);
+
+    add(Execution::observation_schedule, pool + S * N * (k + 1) * value,
+        N * horizon * (model.variate_ns + S * model.step_ns) + S * N * k * model.store_ns,
+        request.need == Output_need::full_path ? "stores every step, as the full grid" : no_pool);
+
+    add(Execution::chunked, S * N * k * value + worker_bytes(request),
+        (S * N * horizon * (model.variate_ns + model.step_ns) + S * N * k * model.store_ns) / W, "");
+
+    add(Execution::streaming, worker_bytes(request), S * N * horizon * (model.variate_ns + model.step_ns) / W,
+        request.keep_slices ? "keeps no slices" : "");
+
+    // Out_of_core holds two chunk grids and the chunk's prices and variates, of at least one path, while it
+    // runs, and each scheme reads its reported step back.
+    std::size_t grids = (2 * (ts + 1) + 2) * value;
+    if (budget > pool + S * N * value + grids) {
+        grids = std::min<std::size_t>(request.num_sims * grids, (budget - pool - S * N * value) / grids * grids);
+    }
+    add(Execution::out_of_core, pool + S * N * value + grids,
+        N * ts * (model.variate_ns + S * (model.step_ns + model.store_ns)) +
+        S * N * (ts + 2) * value / model.disk_bytes_per_second * 1e9, no_pool);
+
+    const Execution_estimate *best = nullptr;
+    for (const auto &e : plan.estimates) {
+        if (e.unavailable.empty() && e.bytes <= budget && (!best || e.seconds < best->seconds)) {
+            best = &e;
+        }
+    }
+
+    if (!best) {
+        print_budget_plan(plan, std::cerr);
+        std::cerr << "Error. No execution fits in " << budget / (1 << 20) << " MB." << '\n';
+        exit(1);
+    }
+    plan.chosen = best->strategy;
+    return plan;
+}
+
+/** \brief      Prints every execution with its estimated memory and time, or why it is unavailable,
+*               and marks the one chosen.
+*/
+void print_budget_plan(const Budget_plan &plan, std::ostream &out) {
+
+    const Run_request &r = plan.request;
+    out << "Run: " << r.schemes.size() << " scheme(s), " << r.num_sims << " paths, " << r.num_timesteps
+        << " steps, storing " << plan.stored_steps.size() << " step(s)"
+        << (r.keep_slices ? "" : " (statistics only)") << ", budget " << plan.budget / (1 << 20) << " MB" << '\n';
+
+    for (const auto &e : plan.estimates) {
+        out << (e.strategy == plan.chosen && e.bytes <= plan.budget && e.unavailable.empty() ? " * " : "   ")
+            << std::setw(22) << std::left << execution_names[static_cast<int>(e.strategy)] << std::right;
+        if (!e.unavailable.empty()) {
+            out << e.unavailable << '\n';
+            continue;
+        }
+        out << std::setw(10) << std::fixed << std::setprecision(1) << e.bytes / double(1 << 20) << " MB"
+            << std::setw(10) << std::setprecision(2) << e.seconds << " s"
+            << (e.bytes > plan.budget ? "  over budget" : "") << '\n';
+        out.unsetf(std::ios::fixed);
+    }
+}
+
+/** \brief 		Runs every scheme of a plan's request with the chosen execution. Pool based
+*				executions (full grid, observation schedule, out of core) share Gaussian_RNs(N x ts,
+*				seed) between the schemes; chunked and streaming ones draw from Block_streams seeded
+*				by seed. Both sample the same law, from different variates.
+*   \param 		plan - The plan from plan_for_budget().
+*   \param      p - Reference to our parameters.
+*   \param      seed - The seed of the variates.
+*   \param      scheduler - The work-stealing scheduler for chunked and streaming execution.
+*   \return		Budget_run . Per scheme, the statistics of the last stored step and, unless
+*				streaming, the stored slices.
+*
+*/
+Budget_run run_budget_plan(const Budget_plan &plan, Parameters &p, std::uint64_t seed, Scheduler &scheduler) {
+
+    SDE_PHASE("budget.run");
+
+    const Run_request &r = plan.request;
+    const std::vector<int> &stored = plan.stored_steps;
+    Budget_run run{std::vector<Running_stats>(r.schemes.size()), stored, {}, nullptr, {}};
+
+    if (plan.chosen == Execution::chunked || plan.chosen == Execution::streaming) {
+        if (plan.chosen == Execution::chunked) {
+            run.slices.assign(r.schemes.size(),
+                              std::vector<std::valarray<double>>(stored.size(), std::valarray<double>(r.num_sims)));
+        }
+        for (std::size_t s = 0; s < r.schemes.size(); ++s) {
+            run.stats[s] = run_blocks(r.schemes[s], p, r.num_sims, r.num_timesteps, stored,
+                                      run.slices.empty() ? nullptr : &run.slices[s], seed, scheduler);
+        }
+        return run;
+    }
+
+    // As in sde_methods, every scheme stays alive until the end of the run, and here after it.
+    int N = static_cast<int>(r.num_sims);
+    run.pool = std::make_unique<Gaussian_RNs>(N * r.num_timesteps, seed);
+    const Gaussian_RNs &pool = *run.pool;
+
+    for (std::size_t s = 0; s < r.schemes.size(); ++s) {
+        if (plan.chosen == Execution::out_of_core) {
+            std::size_t grids = plan.chosen_estimate().bytes - pool.size() * sizeof(double)
+                                - r.schemes.size() * N * sizeof(double);
+            pool.reset_to_start();
+            run.sims.push_back(std::make_unique<Out_of_core>(p, N, r.num_timesteps, pool, scheme_step(r.schemes[s]),
+                                                             grids, "budget_" + r.schemes[s] + ".bin"));
+        } else {
+            std::vector<int> observed = plan.chosen == Execution::observation_schedule ? stored : std::vector<int>{};
+            run.sims.push_back(std::make_unique<Lazy_simulation>(
+                    Simulation_spec{r.schemes[s], p, N, r.num_timesteps, pool.cursor(), observed}));
+        }
+        run.stats[s].add(run.sims.back()->get_valarray_at_step(stored.back()));
+    }
+    return run;
+}
+
+/**  \brief     The paths of one scheme at a stored step. Out of core runs read it from their spill
+*               file into a buffer that the next call for the same scheme overwrites.
+*   \param      scheme - The index of the scheme in the request.
+*   \param      k - The index of the step in stored_steps.
+*   \return     valarray<double>& . The N path values at stored_steps[k]. Exits for a streaming run.
+*
+*/
+std::valarray<double> &Budget_run::slice(std::size_t scheme, std::size_t k) {
+
+    if (!slices.empty()) {
+        return slices[scheme][k];
+    }
+    if (sims.empty()) {
+        std::cerr << "Error. A streaming run keeps no slices." << '\n';
+        exit(1);
+    }
+    return sims[scheme]->get_valarray_at_step(stored_steps[k]);
+}
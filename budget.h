@@ -0,0 +1,99 @@
+#ifndef BUDGET_H_MZHRTQEV
+#define BUDGET_H_MZHRTQEV
+
+#include <vector>
+#include <valarray>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "planner.h"
+#include "scheduler.h"
+
+/**
+ * \brief The ways a run of several schemes over the same N paths and ts steps can be executed.
+ *
+ *  full_grid               one pool of N x ts variates shared by every scheme, each storing every step
+ *  observation_schedule    the same pool, each scheme storing only the steps asked for
+ *  chunked                 no pool: Block_stream blocks on the workers, the steps asked for kept in memory
+ *  streaming               no pool and nothing kept: the statistics are reduced block by block
+ *  out_of_core             the pool, with every step of each scheme in turn spilled to disk (Out_of_core)
+ */
+enum class Execution { full_grid, observation_schedule, chunked, streaming, out_of_core };
+
+/**
+ * \brief What a run has to produce. With keep_slices false only the statistics of the last stored step are
+ *        needed, which allows streaming.
+ */
+struct Run_request {
+    std::vector<std::string> schemes;           //!< exact, milstein or euler_maruyama
+    long num_sims;
+    int num_timesteps;
+    Output_need need;
+    std::vector<int> observation_steps;         //!< When need is schedule
+    bool keep_slices = true;
+    int num_workers = 1;                        //!< Of the scheduler the chunked and streaming runs use
+};
+
+/**
+ * \brief Per-item costs of a run, measured with sde_bench (-O3, one core of an x86-64 server). Only their ratios
+ *        matter when choosing an execution; the absolute estimates are indicative.
+ */
+struct Cost_model {
+    double variate_ns = 31;                     //!< To draw one Gaussian variate (mt19937_64)
+    double step_ns = 9;                         //!< To advance one path by one step
+    double store_ns = 5.5;                      //!< To keep one price in a slice
+    double disk_bytes_per_second = 5e8;         //!< Spill file throughput
+};
+
+/**
+ * \brief The estimated peak memory and time of one execution of a request, or why it cannot run it.
+ */
+struct Execution_estimate {
+    Execution strategy;
+    std::size_t bytes;
+    double seconds;
+    std::string unavailable;                    //!< Empty when the execution can produce the outputs
+};
+
+/**
+ * \brief The execution chosen for a request under a memory budget: the fastest estimate that fits.
+ */
+struct Budget_plan {
+    Run_request request;
+    std::size_t budget;
+    std::vector<int> stored_steps;              //!< Increasing, the last one is reported
+    std::vector<Execution_estimate> estimates;  //!< One per Execution
+    Execution chosen;
+
+    const Execution_estimate &chosen_estimate() const { return estimates[static_cast<int>(chosen)]; }
+};
+
+Budget_plan plan_for_budget(const Run_request &request, std::size_t budget, const Cost_model &model = Cost_model{});
+
+void print_budget_plan(const Budget_plan &plan, std::ostream &out);
+
+/**
+ * \brief What run_budget_plan() produced: per scheme, the statistics of the last stored step and the stored
+ *        slices. A chunked run holds its slices itself. A pool based run holds each scheme's simulation, which
+ *        holds them (on disk when out of core), and the pool the simulations read from. A streaming run holds
+ *        none.
+ */
+struct Budget_run {
+    std::vector<Running_stats> stats;
+    std::vector<int> stored_steps;
+    std::vector<std::vector<std::valarray<double>>> slices;     //!< Chunked: per scheme, per stored step
+    std::unique_ptr<Gaussian_RNs> pool;
+    std::vector<std::unique_ptr<Simulation>> sims;              //!< Pool based: one per scheme
+
+    std::valarray<double> &slice(std::size_t scheme, std::size_t k);
+};
+
+Budget_run run_budget_plan(const Budget_plan &plan, Parameters &p, std::uint64_t seed, Scheduler &scheduler);
+
+#endif /* end of include guard: BUDGET_H_MZHRTQEV */
@@ -0,0 +1,137 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "myrandom.h"
+#include "checkpoint.h"
+#include "instrument.h"
+
+namespace {
+
+const char magic[8] = {'S', 'D', 'E', 'C', 'K', 'P', 'T', '2'};
+
+/**
+ * \brief The fixed-size part of a checkpoint file. It is followed by the key, the run description and the
+ *        statistics bytes.
+ */
+struct Checkpoint_header {
+    char magic[8];
+    std::int64_t num_sims;
+    std::uint64_t seed;
+    std::int64_t paths_per_block;
+    std::int64_t blocks_done;
+    std::uint64_t stats_size;
+    std::uint64_t key_size;
+    std::uint64_t run_size;
+};
+
+} // namespace
+
+/** \brief 		Reads a checkpoint back if its file exists. A file that belongs to another run
+*				(different key, run description, N, seed or block size) or is damaged is an
+*				error, rather than being silently overwritten. The sizes in the header are checked
+*				against the run's before anything is read, so a damaged one cannot ask for a huge
+*				buffer.
+*   \param 		checkpoint - The file and the key of the run.
+*   \param      run - The exact description of the run, see Checkpoint.
+*   \param      N - The number of paths of the run.
+*   \param      seed - The seed of its Block_streams.
+*   \param      stats_size - sizeof the run's statistics.
+*   \param      state - Set to the saved progress when the file exists.
+*   \return		bool . Whether a checkpoint was read.
+*
+*/
+bool load_checkpoint(const Checkpoint &checkpoint, const std::string &run, long N, std::uint64_t seed,
+                     std::size_t stats_size, Checkpoint_state &state) {
+
+    std::ifstream in(checkpoint.filename, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    Checkpoint_header header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+        std::cerr << "Error reading checkpoint " << checkpoint.filename << '\n';
+        exit(1);
+    }
+    if (header.key_size != checkpoint.key.size() || header.run_size != run.size() || header.stats_size != stats_size) {
+        std::cerr << "Error. Checkpoint " << checkpoint.filename << " belongs to another run." << '\n';
+        exit(1);
+    }
+
+    std::string key(header.key_size, '\0');
+    std::string file_run(header.run_size, '\0');
+    state.stats.resize(header.stats_size);
+    in.read(&key[0], header.key_size);
+    in.read(&file_run[0], header.run_size);
+    in.read(state.stats.data(), header.stats_size);
+    if (!in) {
+        std::cerr << "Error reading checkpoint " << checkpoint.filename << '\n';
+        exit(1);
+    }
+    if (key != checkpoint.key || file_run != run || header.num_sims != N || header.seed != seed
+        || header.paths_per_block != Block_stream::paths_per_block) {
+        std::cerr << "Error. Checkpoint " << checkpoint.filename << " belongs to another run (" << key << ")."
+                  << '\n';
+        exit(1);
+    }
+    long num_blocks = (N + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+    if (header.blocks_done < 0 || header.blocks_done > num_blocks) {
+        std::cerr << "Error reading checkpoint " << checkpoint.filename << '\n';
+        exit(1);
+    }
+
+    state.blocks_done = header.blocks_done;
+    std::cout << "Resuming " << checkpoint.key << " from block " << state.blocks_done << " of "
+              << checkpoint.filename << '\n';
+    return true;
+}
+
+/** \brief 		Writes a checkpoint. The file is written under a temporary name and renamed over
+*				the previous one, so a run killed while saving still finds the last complete
+*				checkpoint. Takes its arguments by value so it can run on a writer thread.
+*   \param 		checkpoint - The file and the key of the run.
+*   \param      run - The exact description of the run.
+*   \param      N - The number of paths of the run.
+*   \param      seed - The seed of its Block_streams.
+*   \param      state - The progress to save.
+*
+*/
+void save_checkpoint(Checkpoint checkpoint, std::string run, long N, std::uint64_t seed, Checkpoint_state state) {
+
+    SDE_PHASE("io.checkpoint_write", state.stats.size());
+
+    Checkpoint_header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.num_sims = N;
+    header.seed = seed;
+    header.paths_per_block = Block_stream::paths_per_block;
+    header.blocks_done = state.blocks_done;
+    header.stats_size = state.stats.size();
+    header.key_size = checkpoint.key.size();
+    header.run_size = run.size();
+
+    std::string tmp = checkpoint.filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        out.write(checkpoint.key.data(), checkpoint.key.size());
+        out.write(run.data(), run.size());
+        out.write(state.stats.data(), state.stats.size());
+        out.flush();
+        if (!out) {
+            std::cerr << "Error writing checkpoint " << tmp << '\n';
+            exit(1);
+        }
+    }
+
+    if (std::rename(tmp.c_str(), checkpoint.filename.c_str()) != 0) {
+        std::cerr << "Error renaming checkpoint " << tmp << " to " << checkpoint.filename << '\n';
+        exit(1);
+    }
+}
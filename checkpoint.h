@@ -0,0 +1,37 @@
+#ifndef CHECKPOINT_H_NRKZMFUB
+#define CHECKPOINT_H_NRKZMFUB
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+/**
+ * \brief Where and how often a block-parallel run saves its progress, see parallel_blocks().
+ *
+ * The key names the job for the user. The file also records an exact description of the run, which the
+ * engine calling parallel_blocks() builds from everything its result depends on (payoff, scheme, parameters,
+ * time steps...). Both are checked on resume together with N, the seed and the block size, so a checkpoint
+ * is never resumed into a different run. A checkpoint of a finished run is kept: resuming it returns the
+ * result at once. Delete the file to run again.
+ */
+struct Checkpoint {
+    std::string filename;
+    std::string key;
+    long blocks_per_checkpoint = 256;       //!< Blocks of Block_stream::paths_per_block paths between saves
+};
+
+/**
+ * \brief The progress of a block-parallel run: the number of leading blocks done and the bytes of their
+ *        merged statistics.
+ */
+struct Checkpoint_state {
+    long blocks_done;
+    std::vector<char> stats;
+};
+
+bool load_checkpoint(const Checkpoint &checkpoint, const std::string &run, long N, std::uint64_t seed,
+                     std::size_t stats_size, Checkpoint_state &state);
+
+void save_checkpoint(Checkpoint checkpoint, std::string run, long N, std::uint64_t seed, Checkpoint_state state);
+
+#endif /* end of include guard: CHECKPOINT_H_NRKZMFUB */
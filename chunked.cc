@@ -0,0 +1,226 @@
+#include <valarray>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <future>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "chunked.h"
+#include "instrument.h"
+
+namespace {
+
+/** \brief      Checks the number of paths of an Out_of_core run before anything is built for it.
+*   \return     int . N, when it is at least 1.
+*/
+int checked_paths(int N) {
+
+    if (N < 1) {
+        std::cerr << "Error. Out_of_core needs at least one path." << '\n';
+        exit(1);
+    }
+    return N;
+}
+
+} // namespace
+
+/** \brief 		Constructor for class Out_of_core. The paths are split into chunks sized so that
+*				two (num_ts+1) x chunk grids and the chunk's prices and variates fit in
+*				memory_budget: one chunk is stepped while the previous one is written to disk. Each finished chunk is handed
+*				to a background writer (std::async) and the constructor only waits for it before
+*				handing over the next one.
+*   \param 		p . N . ts . rng . As for the in-memory schemes. Variates are drawn from rng
+*				chunk by chunk, N_chunk per time step.
+*   \param      step - The one-step update of the scheme to simulate, e.g. Exact_path::step.
+*   \param      memory_budget - Bytes available for the in-memory path grids.
+*   \param      filename - The spill file. It is removed when the object is destroyed.
+*
+*/
+Out_of_core::Out_of_core(Parameters &p, int N, int ts, const Gaussian_RNs &rng, Step_function step,
+                         std::size_t memory_budget, std::string filename)
+        : Simulation{p, checked_paths(N), ts, false}, filename_{std::move(filename)} {
+
+    std::cout << "Out_of_core constructor constructing.\n";
+    SDE_PHASE("scheme.out_of_core", static_cast<std::int64_t>(N) * ts);
+
+    std::size_t bytes_per_path = (2 * (num_timesteps() + 1) + 2) * sizeof(double);  //< two grids, prices and rans
+    chunk_paths_ = static_cast<int>(std::min<std::size_t>(N, std::max<std::size_t>(1, memory_budget / bytes_per_path)));
+    num_chunks_ = (N + chunk_paths_ - 1) / chunk_paths_;
+
+    std::cout << "Simulating " << N << " paths in " << num_chunks_ << " chunks of " << chunk_paths_
+              << " paths, spilling to " << filename_ << '\n';
+
+    {
+        std::ofstream create(filename_, std::ios::binary | std::ios::trunc);
+        if (!create.is_open()) {
+            std::cerr << "Error opening spill file " << filename_ << '\n';
+            exit(1);
+        }
+    }
+
+    std::vector<double> grids[2];
+    std::future<void> pending;
+    Step_table table{params, num_timesteps()};
+
+    for (int chunk = 0; chunk < num_chunks_; ++chunk) {
+        std::vector<double> &grid = grids[chunk % 2];
+
+        simulate_chunk(chunk, grid, rng, step, table);  //< Overlaps with the write of the previous chunk
+
+        if (pending.valid()) {
+            pending.get();
+        }
+        pending = std::async(std::launch::async, [this, chunk, &grid] { write_chunk(chunk, grid); });
+    }
+
+    if (pending.valid()) {
+        pending.get();
+    }
+}
+
+/** \brief 		Destructor removes the spill file.
+*/
+Out_of_core::~Out_of_core() {
+    std::remove(filename_.c_str());
+    std::cout << "Out_of_core destructor" << std::endl;
+}
+
+/** \brief 		Steps all paths of one chunk through every time step, storing the chunk's grid
+*				step-major in grid.
+*/
+void Out_of_core::simulate_chunk(int chunk, std::vector<double> &grid, const Gaussian_RNs &rng,
+                                 Step_function step, const Step_table &table) {
+
+    SDE_PHASE("scheme.out_of_core.chunk", static_cast<std::int64_t>(chunk_size(chunk)) * num_timesteps());
+
+    int len = chunk_size(chunk);
+    std::valarray<double> prices(params.S0, len);
+    std::valarray<double> rans(len);
+
+    if (grid.size() != static_cast<std::size_t>(num_timesteps() + 1) * len) {
+        grid.resize(static_cast<std::size_t>(num_timesteps() + 1) * len);
+        SDE_COUNT("bytes_allocated", grid.size() * sizeof(double));
+    }
+    std::copy(std::begin(prices), std::end(prices), grid.begin());
+
+    for (int idx = 1; idx <= num_timesteps(); ++idx) {
+        std::generate(std::begin(rans), std::end(rans), std::ref(rng));
+        step(prices, rans, table[idx - 1], delta_t);
+        std::copy(std::begin(prices), std::end(prices), grid.begin() + static_cast<std::size_t>(idx) * len);
+    }
+}
+
+/** \brief 		Writes one chunk grid to its place in the spill file. Runs on the writer thread.
+*/
+void Out_of_core::write_chunk(int chunk, const std::vector<double> &grid) {
+
+    SDE_PHASE("io.spill_write", grid.size());
+    SDE_COUNT("bytes_written", grid.size() * sizeof(double));
+
+    std::fstream out(filename_, std::ios::binary | std::ios::in | std::ios::out);
+    out.seekp(chunk_offset(chunk));
+    out.write(reinterpret_cast<const char *>(grid.data()), grid.size() * sizeof(double));
+
+    if (!out) {
+        std::cerr << "Error writing chunk " << chunk << " to " << filename_ << '\n';
+        exit(1);
+    }
+}
+
+/** \brief 		Byte offset of the first time step of a chunk in the spill file.
+*/
+std::streamoff Out_of_core::chunk_offset(int chunk) const {
+    return static_cast<std::streamoff>(chunk) * chunk_paths_ * (num_timesteps() + 1) * sizeof(double);
+}
+
+/** \brief 		Number of paths in a chunk. Only the last chunk may be short.
+*/
+int Out_of_core::chunk_size(int chunk) const {
+    return std::min(chunk_paths_, N - chunk * chunk_paths_);
+}
+
+/**  \brief     Reads time step n of every chunk back from the spill file. The returned
+*               reference is to an internal buffer that is overwritten by the next call for a
+*               different time step.
+*   \param      n . The time-step for requested simulated path.
+*   \return     valarray<double>& . The N path values at time step n.
+*
+*/
+std::valarray<double> &Out_of_core::get_valarray_at_step(int n) {
+
+    if (n == cached_step_) {
+        return step_cache_;
+    }
+
+    SDE_PHASE("io.spill_read", N);
+
+    std::ifstream in(filename_, std::ios::binary);
+    step_cache_.resize(N);
+
+    for (int chunk = 0; chunk < num_chunks_; ++chunk) {
+        int len = chunk_size(chunk);
+        in.seekg(chunk_offset(chunk) + static_cast<std::streamoff>(n) * len * sizeof(double));
+        in.read(reinterpret_cast<char *>(&step_cache_[chunk * chunk_paths_]), len * sizeof(double));
+    }
+
+    if (!in) {
+        std::cerr << "Error reading step " << n << " from " << filename_ << '\n';
+        exit(1);
+    }
+
+    cached_step_ = n;
+    return step_cache_;
+}
+
+/** \brief 		Overwrites time step n in the spill file with vals.
+*   \param 		vals - The N path values to store
+*   \param      n - The given time step for vals to be inserted.
+*
+*/
+void Out_of_core::insert_valarray_at_step(std::valarray<double> vals, int n) {
+
+    std::fstream out(filename_, std::ios::binary | std::ios::in | std::ios::out);
+
+    for (int chunk = 0; chunk < num_chunks_; ++chunk) {
+        int len = chunk_size(chunk);
+        out.seekp(chunk_offset(chunk) + static_cast<std::streamoff>(n) * len * sizeof(double));
+        out.write(reinterpret_cast<const char *>(&vals[chunk * chunk_paths_]), len * sizeof(double));
+    }
+
+    if (!out) {
+        std::cerr << "Error writing step " << n << " to " << filename_ << '\n';
+        exit(1);
+    }
+
+    cached_step_ = -1;
+}
+
+/**  \brief     Reads path i back from the spill file, one value per time step.
+*   \param      i . The index of the requested path, 0 <= i < N.
+*   \return     valarray<double> . A valarray of num_timesteps+1 doubles.
+*
+*/
+std::valarray<double> Out_of_core::get_path(int i) {
+
+    int chunk = i / chunk_paths_;
+    int len = chunk_size(chunk);
+    std::valarray<double> path(num_timesteps() + 1);
+    std::ifstream in(filename_, std::ios::binary);
+
+    for (int n = 0; n <= num_timesteps(); ++n) {
+        in.seekg(chunk_offset(chunk) + (static_cast<std::streamoff>(n) * len + i % chunk_paths_) * sizeof(double));
+        in.read(reinterpret_cast<char *>(&path[n]), sizeof(double));
+    }
+
+    if (!in) {
+        std::cerr << "Error reading path " << i << " from " << filename_ << '\n';
+        exit(1);
+    }
+
+    return path;
+}
@@ -0,0 +1,59 @@
+#ifndef CHUNKED_H_QKXWPNDA
+#define CHUNKED_H_QKXWPNDA
+
+#include <valarray>
+#include <vector>
+#include <string>
+#include <future>
+#include <cstddef>
+
+#include "myrandom.h"
+#include "simulation.h"
+
+/**
+ * \brief Simulation whose prices grid lives on disk rather than in memory.
+ *
+ * The paths are simulated in chunks of paths sized so that two chunk grids fit inside the memory
+ * budget. While chunk k+1 is being stepped, chunk k is written to the spill file on a background
+ * thread. On disk each chunk holds its (num_ts+1) time steps one after another, so a time step is
+ * read back with one read per chunk and a path with one read per time step.
+ *
+ * The object behaves as one logical Simulation: get_valarray_at_step() and get_path() read from the
+ * spill file. The reference returned by get_valarray_at_step() points at an internal buffer and is
+ * only valid until the next call.
+ */
+class Out_of_core : public Simulation {
+public:
+    Out_of_core(Parameters &p, int N, int ts, const Gaussian_RNs &rng, Step_function step,
+                std::size_t memory_budget, std::string filename = "out_of_core_prices.bin");
+
+    ~Out_of_core();
+
+    std::valarray<double> &get_valarray_at_step(int n) override;
+
+    void insert_valarray_at_step(std::valarray<double> vals, int n) override;
+
+    std::valarray<double> get_path(int i) override;
+
+    int paths_per_chunk() const { return chunk_paths_; }
+
+    int num_chunks() const { return num_chunks_; }
+
+private:
+    void simulate_chunk(int chunk, std::vector<double> &grid, const Gaussian_RNs &rng, Step_function step,
+                        const Step_table &table);
+
+    void write_chunk(int chunk, const std::vector<double> &grid);
+
+    std::streamoff chunk_offset(int chunk) const;
+
+    int chunk_size(int chunk) const;
+
+    std::string filename_;
+    int chunk_paths_;                   //!< Number of paths in every chunk but possibly the last
+    int num_chunks_;
+    int cached_step_ = -1;              //!< Time step currently held in step_cache_
+    std::valarray<double> step_cache_;
+};
+
+#endif /* end of include guard: CHUNKED_H_QKXWPNDA */
@@ -0,0 +1,172 @@
+#include <vector>
+#include <valarray>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "convergence.h"
+#include "scheduler.h"
+#include "instrument.h"
+
+namespace {
+
+/** \brief      Sums the finest Brownian increments down to a grid that is m times coarser. The
+*               variates are stored step-major (N per time step), so coarse step k of path i is
+*               the sum of fine steps k*m ... k*m+m-1 of path i, rescaled to unit variance.
+*/
+Path_vector<double> coarsen(const Gaussian_RNs &fine, int N, int fine_ts, int m) {
+
+    int coarse_ts = fine_ts / m;
+    double scale = 1 / std::sqrt(static_cast<double>(m));
+    const double *z = fine.data();
+    Path_vector<double> coarse(static_cast<std::size_t>(N) * coarse_ts, 0.0);
+
+    for (int k = 0; k < coarse_ts; ++k) {
+        double *out = &coarse[static_cast<std::size_t>(k) * N];
+        for (int j = 0; j < m; ++j) {
+            const double *in = z + static_cast<std::size_t>(k * m + j) * N;
+            for (int i = 0; i < N; ++i) {
+                out[i] += in[i];
+            }
+        }
+        for (int i = 0; i < N; ++i) {
+            out[i] *= scale;
+        }
+    }
+
+    return coarse;
+}
+
+/** \brief      Mean of vals with the half-width of its 95% confidence interval.
+*/
+Error_estimate estimate(const std::valarray<double> &vals) {
+    double sd = std::sqrt(std::max(variance(vals), 0.0));
+    return Error_estimate{expected_value(vals), 1.96 * sd / std::sqrt(static_cast<double>(vals.size()))};
+}
+
+/** \brief      Least-squares slope of log(error) against log(delta_t), i.e. the order p in
+*               error ~ C * delta_t^p. Resolutions whose error is zero are skipped.
+*/
+double fitted_order(const std::vector<Convergence_point> &points, Error_estimate Convergence_point::*err) {
+
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int n = 0;
+
+    for (const auto &pt : points) {
+        double e = std::abs((pt.*err).value);
+        if (e <= 0) {
+            continue;
+        }
+        double x = std::log(pt.delta_t);
+        double y = std::log(e);
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
+        ++n;
+    }
+
+    if (n < 2) {
+        return NAN;
+    }
+    return (n * sxy - sx * sy) / (n * sxx - sx * sx);
+}
+
+} // namespace
+
+/** \brief 		Runs a strong/weak convergence study of Euler-Maruyama and Milstein against the
+*				exact scheme. The Brownian increments of the finest resolution are drawn once, and
+*				every coarser resolution is built by summing them, so all resolutions and schemes
+*				see the same Brownian paths and the errors are not swamped by independent noise.
+*				Only the terminal slices are compared, so only those are kept.
+*   \param 		p - Reference to our parameters (strike, vol, time, etc.)
+*   \param      N - The number of Monte Carlo simulations
+*   \param      timesteps - The resolutions to compare. The largest must be a multiple of all
+*				others.
+*   \param      scheduler - The reference is stepped on the scheduler in blocks of paths, then the
+*				resolutions run as separate tasks on it.
+*   \return		Convergence_study . The errors at each resolution and the fitted orders.
+*
+*/
+Convergence_study run_convergence_study(Parameters &p, int N, std::vector<int> timesteps, Scheduler &scheduler) {
+
+    SDE_PHASE("convergence.study");
+
+    std::sort(timesteps.begin(), timesteps.end());
+    int fine_ts = timesteps.back();
+
+    for (int ts : timesteps) {
+        if (ts <= 0 || fine_ts % ts != 0) {
+            std::cerr << "Error. Number of time steps " << ts << " does not divide the finest resolution "
+                      << fine_ts << "." << '\n';
+            exit(1);
+        }
+    }
+
+    const Gaussian_RNs fine{N * fine_ts};
+
+    // The exact solution at the finest resolution is the reference for every resolution.
+    Exact_path exact{p, N, fine_ts, fine.cursor(), {fine_ts}, &scheduler};
+    const std::valarray<double> reference = exact.get_valarray_at_step(fine_ts);
+
+    Convergence_study study{N, std::vector<Convergence_point>(timesteps.size()), 0, 0, 0, 0};
+
+    scheduler.parallel_for(static_cast<int>(timesteps.size()), [&](int r) {
+        int ts = timesteps[r];
+        const Gaussian_RNs coarse{coarsen(fine, N, fine_ts, fine_ts / ts)};
+
+        Euler_Maruyama em{p, N, ts, coarse, {ts}};
+        coarse.reset_to_start();
+        Milstein m{p, N, ts, coarse, {ts}};
+
+        std::valarray<double> em_diff = em.get_valarray_at_step(ts) - reference;
+        std::valarray<double> m_diff = m.get_valarray_at_step(ts) - reference;
+
+        Convergence_point pt{ts, (p.T - p.t0) / ts, estimate(std::abs(em_diff)), estimate(em_diff),
+                             estimate(std::abs(m_diff)), estimate(m_diff)};
+        pt.em_weak.value = std::abs(pt.em_weak.value);
+        pt.m_weak.value = std::abs(pt.m_weak.value);
+        study.points[r] = pt;
+    });
+
+    study.em_strong_order = fitted_order(study.points, &Convergence_point::em_strong);
+    study.em_weak_order = fitted_order(study.points, &Convergence_point::em_weak);
+    study.m_strong_order = fitted_order(study.points, &Convergence_point::m_strong);
+    study.m_weak_order = fitted_order(study.points, &Convergence_point::m_weak);
+
+    return study;
+}
+
+/** \brief      Writes one row per resolution: delta_t, then the strong and weak errors of
+*               Euler-Maruyama and Milstein, each followed by its 95% confidence half-width.
+*               The fitted orders are written as a trailing comment.
+*/
+void write_convergence_to_file(const Convergence_study &study, std::string filename) {
+
+    std::cout << "Writing results to file: " << filename << '\n';
+
+    std::ofstream outfile;
+    outfile.open(filename);
+
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening outfile." << '\n';
+        exit(1);
+    }
+
+    outfile << "# timesteps\tdelta_t\tEM_strong\tci\tEM_weak\tci\tM_strong\tci\tM_weak\tci\n";
+    for (const auto &pt : study.points) {
+        outfile << pt.num_timesteps << '\t' << pt.delta_t << '\t'
+                << pt.em_strong.value << '\t' << pt.em_strong.half_width << '\t'
+                << pt.em_weak.value << '\t' << pt.em_weak.half_width << '\t'
+                << pt.m_strong.value << '\t' << pt.m_strong.half_width << '\t'
+                << pt.m_weak.value << '\t' << pt.m_weak.half_width << std::endl;
+    }
+
+    outfile << "# orders\tEM_strong " << study.em_strong_order << "\tEM_weak " << study.em_weak_order
+            << "\tM_strong " << study.m_strong_order << "\tM_weak " << study.m_weak_order << std::endl;
+}
@@ -0,0 +1,49 @@
+#ifndef CONVERGENCE_H_MWQZLBTE
+#define CONVERGENCE_H_MWQZLBTE
+
+#include <vector>
+#include <string>
+
+#include "simulation.h"
+#include "scheduler.h"
+
+/**
+ * \brief An error estimate with the half-width of its 95% confidence interval.
+ */
+struct Error_estimate {
+    double value = 0;
+    double half_width = 0;
+};
+
+/**
+ * \brief Strong and weak errors of Euler-Maruyama and Milstein at one time step size.
+ *
+ * Strong error is E|S_T - S_T^exact|, weak error is |E[S_T] - E[S_T^exact]|, both measured on the same
+ * Brownian paths as the exact solution.
+ */
+struct Convergence_point {
+    int num_timesteps;
+    double delta_t;
+    Error_estimate em_strong;
+    Error_estimate em_weak;
+    Error_estimate m_strong;
+    Error_estimate m_weak;
+};
+
+/**
+ * \brief Errors at every resolution and the convergence orders fitted to them.
+ */
+struct Convergence_study {
+    int num_sims;
+    std::vector<Convergence_point> points;
+    double em_strong_order;
+    double em_weak_order;
+    double m_strong_order;
+    double m_weak_order;
+};
+
+Convergence_study run_convergence_study(Parameters &p, int N, std::vector<int> timesteps, Scheduler &scheduler);
+
+void write_convergence_to_file(const Convergence_study &study, std::string filename);
+
+#endif /* end of include guard: CONVERGENCE_H_MWQZLBTE */
@@ -2,7 +2,11 @@
 #include <valarray>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include "empirical.h"
+#include "instrument.h"
 
 /** \brief      This function takes a valarray of doubles, computes the expected value, or
 *               mean of that valarray and returns this value.
@@ -12,6 +16,8 @@
 */
 double expected_value(const std::valarray<double> &vals) {
 
+    SDE_PHASE("stats.expected_value", vals.size());
+
     try {
         double avg = vals.sum() / vals.size();
         return avg;
@@ -31,6 +37,8 @@ double expected_value(const std::valarray<double> &vals) {
 */
 double variance(const std::valarray<double> &vals) {
 
+    SDE_PHASE("stats.variance", vals.size());
+
     return expected_value(vals * vals) - std::pow(expected_value(vals), 2);
 
 }
@@ -52,6 +60,8 @@ double variance(const std::valarray<double> &vals) {
 */
 std::map<double, double> create_density_hist(const std::valarray<double> &vals, const int num_bins) {
 
+    SDE_PHASE("stats.density_hist", vals.size());
+
     double range = vals.max() - vals.min();            //< Find range
     double bin_stepsize = range / num_bins;            //< Find width of each bin from (max-min)/number_of_bins
 
@@ -81,6 +91,8 @@ std::map<double, double> create_density_hist(const std::valarray<double> &vals,
 */
 void write_hist_to_file(std::map<double, double> &in, std::string filename) {
 
+    SDE_PHASE("io.write_hist", in.size());
+
     std::cout << "Writing results to file: " << filename << '\n';
 
     std::ofstream outfile;
@@ -97,3 +109,267 @@ void write_hist_to_file(std::map<double, double> &in, std::string filename) {
 
 }
 
+/** \brief      Adds one value to the running statistics.
+*/
+void Running_stats::add(double x) {
+
+    if (n_ == 0) {
+        min_ = max_ = x;
+    } else {
+        min_ = std::min(min_, x);
+        max_ = std::max(max_, x);
+    }
+
+    ++n_;
+    double delta = x - mean_;
+    mean_ += delta / n_;
+    m2_ += delta * (x - mean_);
+}
+
+/** \brief      Adds every value of a valarray to the running statistics.
+*/
+void Running_stats::add(const std::valarray<double> &vals) {
+
+    SDE_PHASE("stats.running", vals.size());
+
+    for (double x : vals) {
+        add(x);
+    }
+}
+
+/** \brief      Merges the statistics of a disjoint set of values into this one.
+*/
+void Running_stats::merge(const Running_stats &other) {
+
+    if (other.n_ == 0) {
+        return;
+    }
+    if (n_ == 0) {
+        *this = other;
+        return;
+    }
+
+    long n = n_ + other.n_;
+    double delta = other.mean_ - mean_;
+    mean_ += delta * other.n_ / n;
+    m2_ += other.m2_ + delta * delta * (static_cast<double>(n_) * other.n_ / n);
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    n_ = n;
+}
+
+/** \brief      Adds a batch of values. The first non-empty batch fixes the bin width.
+*/
+void Running_histogram::add(const std::valarray<double> &vals) {
+
+    if (vals.size() == 0) {
+        return;
+    }
+    if (bin_width_ == 0) {
+        bin_width_ = (vals.max() - vals.min()) / num_bins_;
+        if (bin_width_ == 0) {
+            bin_width_ = 1;                                 //< all values equal: any width gives one bin
+        }
+    }
+
+    for (double x : vals) {
+        ++counts_[static_cast<long>(x / bin_width_)];       //< truncates towards zero as create_density_hist()
+    }
+    n_ += vals.size();
+}
+
+/** \brief      Adds the counts of another histogram with the same bin width.
+*/
+void Running_histogram::merge(const Running_histogram &other) {
+
+    if (other.n_ == 0) {
+        return;
+    }
+    if (n_ == 0) {
+        *this = other;
+        return;
+    }
+    if (other.bin_width_ != bin_width_) {
+        std::cerr << "Error. Cannot merge histograms with different bin widths." << '\n';
+        exit(1);
+    }
+
+    for (const auto &c : other.counts_) {
+        counts_[c.first] += c.second;
+    }
+    n_ += other.n_;
+}
+
+/** \brief      The density of every bin so far, keyed by the bin's lower edge, in the format
+*               of create_density_hist().
+*/
+std::map<double, double> Running_histogram::density() const {
+
+    std::map<double, double> hist;
+    for (const auto &c : counts_) {
+        hist[c.first * bin_width_] = static_cast<double>(c.second) / n_;
+    }
+    return hist;
+}
+
+namespace {
+
+/** \brief      Writes a map of integer keys and counts as its size followed by the pairs.
+*/
+template <typename Key>
+void write_counts(std::ostream &out, const std::map<Key, long> &counts) {
+
+    std::uint64_t size = counts.size();
+    out.write(reinterpret_cast<const char *>(&size), sizeof(size));
+    for (const auto &c : counts) {
+        std::int64_t key = c.first;
+        std::int64_t count = c.second;
+        out.write(reinterpret_cast<const char *>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    }
+}
+
+template <typename Key>
+void read_counts(std::istream &in, std::map<Key, long> &counts) {
+
+    std::uint64_t size = 0;
+    in.read(reinterpret_cast<char *>(&size), sizeof(size));
+    counts.clear();
+    for (std::uint64_t i = 0; i < size && in; ++i) {
+        std::int64_t key = 0;
+        std::int64_t count = 0;
+        in.read(reinterpret_cast<char *>(&key), sizeof(key));
+        in.read(reinterpret_cast<char *>(&count), sizeof(count));
+        counts[static_cast<Key>(key)] = count;
+    }
+}
+
+} // namespace
+
+/** \brief      Writes the histogram in binary: number of bins, bin width, count and the bins.
+*/
+void Running_histogram::write(std::ostream &out) const {
+
+    std::int64_t num_bins = num_bins_;
+    std::int64_t n = n_;
+    out.write(reinterpret_cast<const char *>(&num_bins), sizeof(num_bins));
+    out.write(reinterpret_cast<const char *>(&bin_width_), sizeof(bin_width_));
+    out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+    write_counts(out, counts_);
+}
+
+/** \brief      Reads back a histogram written by write().
+*/
+void Running_histogram::read(std::istream &in) {
+
+    std::int64_t num_bins = 0;
+    std::int64_t n = 0;
+    in.read(reinterpret_cast<char *>(&num_bins), sizeof(num_bins));
+    in.read(reinterpret_cast<char *>(&bin_width_), sizeof(bin_width_));
+    in.read(reinterpret_cast<char *>(&n), sizeof(n));
+    read_counts(in, counts_);
+    num_bins_ = static_cast<int>(num_bins);
+    n_ = n;
+}
+
+/** \brief      Constructs an empty sketch answering quantiles within relative error alpha.
+*/
+Quantile_sketch::Quantile_sketch(double alpha)
+        : alpha_{alpha}, log_gamma_{std::log((1 + alpha) / (1 - alpha))} {
+
+    if (alpha <= 0 || alpha >= 1) {
+        std::cerr << "Error. The sketch accuracy must lie in (0, 1)." << '\n';
+        exit(1);
+    }
+}
+
+/** \brief      Adds a batch of values: value x > 0 goes to bucket ceil(log_gamma(x)).
+*/
+void Quantile_sketch::add(const std::valarray<double> &vals) {
+
+    for (double x : vals) {
+        if (x <= 0) {
+            ++non_positive_;
+        } else {
+            ++buckets_[static_cast<int>(std::ceil(std::log(x) / log_gamma_))];
+        }
+    }
+    n_ += vals.size();
+}
+
+/** \brief      Adds the counts of another sketch with the same accuracy. An empty sketch takes
+*               the other's accuracy.
+*/
+void Quantile_sketch::merge(const Quantile_sketch &other) {
+
+    if (other.n_ == 0) {
+        return;
+    }
+    if (n_ == 0) {
+        *this = other;
+        return;
+    }
+    if (other.alpha_ != alpha_) {
+        std::cerr << "Error. Cannot merge sketches with different accuracies." << '\n';
+        exit(1);
+    }
+
+    for (const auto &b : other.buckets_) {
+        buckets_[b.first] += b.second;
+    }
+    non_positive_ += other.non_positive_;
+    n_ += other.n_;
+}
+
+/** \brief      The q-quantile, 0 <= q <= 1, within relative error alpha. The value of rank
+*               floor(q * (count - 1)) is located and its bucket's midpoint 2 gamma^i / (gamma + 1)
+*               returned. Values <= 0 are reported as 0.
+*/
+double Quantile_sketch::quantile(double q) const {
+
+    if (n_ == 0) {
+        return NAN;
+    }
+
+    long rank = static_cast<long>(q * (n_ - 1));
+    if (rank < non_positive_) {
+        return 0;
+    }
+
+    long seen = non_positive_;
+    double gamma = std::exp(log_gamma_);
+    for (const auto &b : buckets_) {
+        seen += b.second;
+        if (seen > rank) {
+            return 2 * std::exp(b.first * log_gamma_) / (gamma + 1);
+        }
+    }
+    return 2 * std::exp(buckets_.rbegin()->first * log_gamma_) / (gamma + 1);
+}
+
+/** \brief      Writes the sketch in binary: accuracy, counts and the buckets.
+*/
+void Quantile_sketch::write(std::ostream &out) const {
+
+    std::int64_t n = n_;
+    std::int64_t non_positive = non_positive_;
+    out.write(reinterpret_cast<const char *>(&alpha_), sizeof(alpha_));
+    out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+    out.write(reinterpret_cast<const char *>(&non_positive), sizeof(non_positive));
+    write_counts(out, buckets_);
+}
+
+/** \brief      Reads back a sketch written by write().
+*/
+void Quantile_sketch::read(std::istream &in) {
+
+    std::int64_t n = 0;
+    std::int64_t non_positive = 0;
+    in.read(reinterpret_cast<char *>(&alpha_), sizeof(alpha_));
+    in.read(reinterpret_cast<char *>(&n), sizeof(n));
+    in.read(reinterpret_cast<char *>(&non_positive), sizeof(non_positive));
+    read_counts(in, buckets_);
+    log_gamma_ = std::log((1 + alpha_) / (1 - alpha_));
+    n_ = n;
+    non_positive_ = non_positive;
+}
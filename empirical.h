@@ -4,6 +4,7 @@
 #include <map>
 #include <valarray>
 #include <string>
+#include <iostream>
 
 // Function prototypes
 std::map<double, double> create_density_hist(const std::valarray<double> &vals, const int num_bins = 100);
@@ -11,5 +12,103 @@ void write_hist_to_file(std::map<double, double> &in, std::string filename);
 double variance(const std::valarray<double> &vals);
 double expected_value(const std::valarray<double> &vals);
 
+/**
+ * \brief Streaming mean, variance, minimum and maximum of a sequence of values.
+ *
+ * Values are added one at a time (Welford's update) and two accumulators over disjoint sets of values can
+ * be merged (Chan et al.), so each thread can keep its own and merge them at the end. variance() is the
+ * population variance, as computed by variance() above.
+ */
+class Running_stats {
+public:
+    void add(double x);
+
+    void add(const std::valarray<double> &vals);
+
+    void merge(const Running_stats &other);
+
+    long count() const { return n_; }
+
+    double mean() const { return mean_; }
+
+    double variance() const { return n_ > 0 ? m2_ / n_ : 0.0; }
+
+    double min() const { return min_; }
+
+    double max() const { return max_; }
+
+private:
+    long n_ = 0;
+    double mean_ = 0;
+    double m2_ = 0;         //!< Sum of squared deviations from the mean
+    double min_ = 0;
+    double max_ = 0;
+};
+
+/**
+ * \brief Streaming density histogram with the bins of create_density_hist().
+ *
+ * The bin width is fixed by the first batch added, as (max - min) / num_bins of that batch, and bins are
+ * multiples of it as in create_density_hist(). Later batches only increment counts, so a histogram of a
+ * growing set of values never has to see the earlier ones again. Values outside the first batch's range
+ * open new bins of the same width. Histograms built separately (threads, processes) can only be merged when
+ * they share a bin width, so those are given one up front. Counts are integers, so merging is exact in any
+ * order.
+ */
+class Running_histogram {
+public:
+    explicit Running_histogram(int num_bins = 100) : num_bins_{num_bins} {}
+
+    Running_histogram(int num_bins, double bin_width) : num_bins_{num_bins}, bin_width_{bin_width} {}
+
+    void add(const std::valarray<double> &vals);
+
+    void merge(const Running_histogram &other);
+
+    std::map<double, double> density() const;
+
+    long count() const { return n_; }
+
+    void write(std::ostream &out) const;
+
+    void read(std::istream &in);
+
+private:
+    int num_bins_;
+    double bin_width_ = 0;      //!< 0 until the first batch
+    long n_ = 0;
+    std::map<long, long> counts_;
+};
+
+/**
+ * \brief Mergeable quantile sketch with a relative accuracy guarantee (DDSketch, Masson et al. 2019).
+ *
+ * Positive values are counted in logarithmic buckets (gamma^(i-1), gamma^i] with gamma = (1 + alpha) / (1 - alpha),
+ * and every quantile is answered within a relative error alpha. Values <= 0 share one bucket. The state is the
+ * bucket counts only, so sketches merge exactly: a sketch of several shards is the sketch of one big run.
+ */
+class Quantile_sketch {
+public:
+    explicit Quantile_sketch(double alpha = 0.005);
+
+    void add(const std::valarray<double> &vals);
+
+    void merge(const Quantile_sketch &other);
+
+    double quantile(double q) const;
+
+    long count() const { return n_; }
+
+    void write(std::ostream &out) const;
+
+    void read(std::istream &in);
+
+private:
+    double alpha_;
+    double log_gamma_;
+    long n_ = 0;
+    long non_positive_ = 0;     //!< Values <= 0
+    std::map<int, long> buckets_;
+};
 
 #endif /* end of include guard: EMPIRICAL_H_HHVMOMRI */
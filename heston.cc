@@ -0,0 +1,186 @@
+#include <valarray>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "heston.h"
+#include "scheduler.h"
+#include "instrument.h"
+
+namespace {
+
+/**
+ * \brief Streaming statistics of the terminal prices and variances of a block of paths.
+ */
+struct Heston_stats {
+    Running_stats price;
+    Running_stats variance;
+
+    void merge(const Heston_stats &other) {
+        price.merge(other.price);
+        variance.merge(other.variance);
+    }
+};
+
+} // namespace
+
+/** \brief 		Simulates Heston paths with the QE scheme and stores the prices at every step, or
+*				at the observed steps only.
+*   \param 		p . h . N . ts . rng . p is a reference to a Parameters structure (sigma is
+*				unused) and h holds the variance process. N is the number of simulation paths and
+*				ts is the number of steps between t0 and T. rng is a cursor over a pool of
+*				Gaussian variates, of which the 2 x N x ts from its position on are used.
+*   \param      observation_steps - The steps to keep, every step when empty.
+*
+*/
+Heston::Heston(Parameters &p, const Heston_parameters &h, int N, int ts, Variate_cursor rng,
+               std::vector<int> observation_steps)
+        : Simulation{p, N, ts, std::move(observation_steps)} {
+
+    std::cout << "Heston constructor constructing.\n";
+    SDE_PHASE("scheme.heston", static_cast<std::int64_t>(N) * ts);
+
+    std::valarray<double> log_prices(std::log(params.S0), N);
+    std::valarray<double> variances(h.v0, N);
+    std::valarray<double> z_v(N);
+    std::valarray<double> z_x(N);
+    Step_table table{params, num_timesteps()};
+
+    for (int idx = 1; idx <= num_timesteps(); ++idx) {
+        rng.fill(&z_v[0], N);
+        rng.fill(&z_x[0], N);
+        step(log_prices, variances, z_v, z_x, table[idx - 1], h, delta_t);
+        if (is_observed(idx)) {
+            get_valarray_at_step(idx) = std::exp(log_prices);
+        }
+    }
+}
+
+/** \brief 		As above, reading the variates through rng's shared cursor, which is advanced past
+*				the 2 x N x ts variates used as if they had been drawn one by one.
+*/
+Heston::Heston(Parameters &p, const Heston_parameters &h, int N, int ts, const Gaussian_RNs &rng,
+               std::vector<int> observation_steps)
+        : Heston{p, h, N, ts, rng.cursor(rng.position()), std::move(observation_steps)} {
+    rng.advance(2L * N * ts);
+}
+
+/** \brief 		One Quadratic-Exponential step (Andersen, 2008) applied in place to a set of
+*				paths. The variance moves by matching the first two moments of its exact
+*				conditional distribution: a scaled non-central chi-square with one degree of
+*				freedom, a*(b + z_v)^2, when it is concentrated (psi <= 1.5), and a point mass at
+*				zero mixed with an exponential otherwise. The log-price uses the trapezoidal rule
+*				for the integrated variance (gamma1 = gamma2 = 1/2), with Andersen's martingale
+*				correction so that E[S_T] = S0*exp(mu*T). The correction only exists while A <
+*				1/(2a) and A < beta; a step that breaks either condition, which happens with a
+*				positive rho and long time steps, is an error.
+*   \param 		log_prices . variances . z_v . z_x . log_prices and variances hold the values at
+*				the current step and are overwritten with the values at the next step. z_v and z_x
+*				hold one independent standard normal per path. The correlation enters through the
+*				drift coefficients K1 and K2.
+*/
+void Heston::step(std::valarray<double> &log_prices, std::valarray<double> &variances,
+                  const std::valarray<double> &z_v, const std::valarray<double> &z_x, const Parameters &p,
+                  const Heston_parameters &h, double delta_t) {
+
+    const double psi_c = 1.5;
+    double e = std::exp(-h.kappa * delta_t);
+    double c1 = h.xi * h.xi * e * (1 - e) / h.kappa;
+    double c2 = h.theta * h.xi * h.xi * (1 - e) * (1 - e) / (2 * h.kappa);
+    double k1 = 0.5 * delta_t * (h.kappa * h.rho / h.xi - 0.5) - h.rho / h.xi;
+    double k2 = 0.5 * delta_t * (h.kappa * h.rho / h.xi - 0.5) + h.rho / h.xi;
+    double k3 = 0.5 * delta_t * (1 - h.rho * h.rho);
+    double A = k2 + 0.5 * k3;                                   //< k4 = k3 when gamma1 = gamma2
+    double drift = p.mu * delta_t;
+
+    for (std::size_t i = 0; i < log_prices.size(); ++i) {
+        double v = variances[i];
+        double m = h.theta + (v - h.theta) * e;
+        double psi = (v * c1 + c2) / (m * m);
+        double v_next;
+        double log_M;                                           //< log E[exp(A * v_next)]
+
+        if (psi <= psi_c) {
+            double two_over_psi = 2 / psi;
+            double b2 = two_over_psi - 1 + std::sqrt(two_over_psi * (two_over_psi - 1));
+            double a = m / (1 + b2);
+            double b = std::sqrt(b2);
+            v_next = a * (b + z_v[i]) * (b + z_v[i]);
+            if (2 * A * a >= 1) {
+                std::cerr << "Error. The Heston martingale correction needs A < 1/(2a); take smaller time steps."
+                          << '\n';
+                exit(1);
+            }
+            log_M = A * b2 * a / (1 - 2 * A * a) - 0.5 * std::log(1 - 2 * A * a);
+        } else {
+            double mass = (psi - 1) / (psi + 1);
+            double beta = (1 - mass) / m;
+            double one_minus_u = 0.5 * std::erfc(z_v[i] * M_SQRT1_2);    //< 1 - Phi(z_v)
+            v_next = one_minus_u >= 1 - mass ? 0.0 : std::log((1 - mass) / one_minus_u) / beta;
+            if (A >= beta) {
+                std::cerr << "Error. The Heston martingale correction needs A < beta; take smaller time steps." << '\n';
+                exit(1);
+            }
+            log_M = std::log(mass + beta * (1 - mass) / (beta - A));
+        }
+
+        double k0 = -log_M - (k1 + 0.5 * k3) * v;
+        log_prices[i] += drift + k0 + k1 * v + k2 * v_next + std::sqrt(k3 * (v + v_next)) * z_x[i];
+        variances[i] = v_next;
+    }
+}
+
+/** \brief 		Simulates N Heston paths on the scheduler's workers and keeps only their terminal
+*				slices. Paths are split into Block_stream blocks as price_option(), each holding
+*				the current log-price and variance of its paths and the two variates of one step,
+*				allocated once per block.
+*   \param 		p - Reference to our parameters (sigma is unused).
+*   \param      h - The variance process.
+*   \param      N - The number of Monte Carlo simulations
+*   \param      ts - The number of time steps
+*   \param      seed - The seed of the Block_streams.
+*   \param      scheduler - The work-stealing scheduler to run on.
+*   \return		Heston_terminal . The prices and variances at T with their statistics.
+*
+*/
+Heston_terminal simulate_heston_terminal(const Parameters &p, const Heston_parameters &h, long N, int ts,
+                                         std::uint64_t seed, Scheduler &scheduler) {
+
+    SDE_PHASE("heston.total");
+
+    double delta_t = (p.T - p.t0) / ts;
+    Step_table table{p, ts};
+    Heston_terminal out{std::valarray<double>(N), std::valarray<double>(N), Running_stats{}, Running_stats{}};
+
+    auto paths = [&](long first, int n, auto draw, Heston_stats &st) {
+        SDE_PHASE("heston.paths", static_cast<long>(n) * ts);
+
+        std::valarray<double> log_prices(std::log(p.S0), n);
+        std::valarray<double> variances(h.v0, n);
+        std::valarray<double> z_v(n);
+        std::valarray<double> z_x(n);
+
+        for (int k = 0; k < ts; ++k) {
+            draw(&z_v[0], n);
+            draw(&z_x[0], n);
+            Heston::step(log_prices, variances, z_v, z_x, table[k], h, delta_t);
+        }
+
+        std::valarray<double> prices = std::exp(log_prices);
+        out.prices[std::slice(first, n, 1)] = prices;
+        out.variances[std::slice(first, n, 1)] = variances;
+        st.price.add(prices);
+        st.variance.add(variances);
+    };
+    Heston_stats stats = parallel_blocks<Heston_stats>(scheduler, N, seed, paths);
+
+    out.price_stats = stats.price;
+    out.variance_stats = stats.variance;
+    return out;
+}
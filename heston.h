@@ -0,0 +1,66 @@
+#ifndef HESTON_H_PLWVJNQA
+#define HESTON_H_PLWVJNQA
+
+#include <valarray>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+
+/**
+ * \brief Parameters of the Heston variance process dv = kappa*(theta - v)*dt + xi*sqrt(v)*dW_v, with
+ *        d<W_v, W_S> = rho*dt. The price follows dS = mu*S*dt + sqrt(v)*S*dW_S, so sigma and
+ *        local_vol are unused.
+ */
+struct Heston_parameters {
+    double v0 = 0.04;          //!< Initial variance
+    double kappa = 1.5;        //!< Speed of mean reversion of the variance
+    double theta = 0.04;       //!< Long run variance
+    double xi = 0.5;           //!< Volatility of the variance
+    double rho = -0.7;         //!< Correlation of the price and variance Brownian motions
+};
+
+/* ------------------------------------- Heston QE method ------------------------------------ */
+
+/**
+ * \brief a Class to create Heston simulation paths using Andersen's Quadratic-Exponential scheme
+ *
+ * Each step draws N variates for the variance and then N for the log-price. The uniform of the exponential
+ * branch of the variance step is Phi(z_v), so the variance variate serves both branches.
+ */
+class Heston : public Simulation {
+public:
+    Heston(Parameters &p, const Heston_parameters &h, int N, int ts, const Gaussian_RNs &rng,
+           std::vector<int> observation_steps = {});
+
+    Heston(Parameters &p, const Heston_parameters &h, int N, int ts, Variate_cursor rng,
+           std::vector<int> observation_steps = {});
+
+    static void step(std::valarray<double> &log_prices, std::valarray<double> &variances,
+                     const std::valarray<double> &z_v, const std::valarray<double> &z_x, const Parameters &p,
+                     const Heston_parameters &h, double delta_t);
+
+    ~Heston() {
+        std::cout << "Heston destructor" << std::endl;
+    };
+};
+
+/**
+ * \brief Terminal slices of a Heston run, the price and the variance of every path at T, with their streaming
+ *        statistics.
+ */
+struct Heston_terminal {
+    std::valarray<double> prices;
+    std::valarray<double> variances;
+    Running_stats price_stats;
+    Running_stats variance_stats;
+};
+
+Heston_terminal simulate_heston_terminal(const Parameters &p, const Heston_parameters &h, long N, int ts,
+                                         std::uint64_t seed, Scheduler &scheduler);
+
+#endif /* end of include guard: HESTON_H_PLWVJNQA */
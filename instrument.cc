@@ -0,0 +1,236 @@
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+#include "instrument.h"
+#include "perf_counters.h"
+
+namespace instrument {
+
+namespace {
+
+#ifdef SDE_PERF_COUNTERS
+const bool hw_compiled_in = true;       //!< Whether phases try to read the hardware counters
+#else
+const bool hw_compiled_in = false;
+#endif
+
+/**
+ * \brief Accumulated calls, time and items of one named phase or counter.
+ */
+struct Record {
+    const char *name;
+    std::int64_t calls = 0;
+    std::int64_t ns = 0;
+    std::int64_t items = 0;     //!< Items processed (phases) or the counter value (counters)
+    std::int64_t hw_calls = 0;  //!< Calls for which hardware counters were read
+    std::int64_t hw[perf_counters::num_events] = {};
+};
+
+/** \brief      Finds the record for name, adding it if it is new. Names are string literals, so
+*               the pointer comparison almost always hits before strcmp is needed.
+*/
+Record &find(std::vector<Record> &records, const char *name) {
+
+    for (auto &r : records) {
+        if (r.name == name || std::strcmp(r.name, name) == 0) {
+            return r;
+        }
+    }
+
+    records.push_back(Record{name});
+    return records.back();
+}
+
+void merge(std::vector<Record> &into, const std::vector<Record> &from) {
+    for (const auto &r : from) {
+        Record &dst = find(into, r.name);
+        dst.calls += r.calls;
+        dst.ns += r.ns;
+        dst.items += r.items;
+        dst.hw_calls += r.hw_calls;
+        for (int e = 0; e < perf_counters::num_events; ++e) {
+            dst.hw[e] += r.hw[e];
+        }
+    }
+}
+
+void print_text(const std::vector<Record> &phases, const std::vector<Record> &counters, std::ostream &out);
+
+void print_json(const std::vector<Record> &phases, const std::vector<Record> &counters, const std::string &filename);
+
+/**
+ * \brief Totals merged from every thread. Writes the report when destroyed at program exit.
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<Record> phases;
+    std::vector<Record> counters;
+
+    ~Registry() {
+        if (phases.empty() && counters.empty()) {
+            return;
+        }
+        print_text(phases, counters, std::cerr);
+        const char *filename = std::getenv("SDE_PHASE_REPORT");
+        print_json(phases, counters, filename ? filename : "phase_report.json");
+    }
+};
+
+Registry &registry() {
+    static Registry r;
+    return r;
+}
+
+/**
+ * \brief Per-thread buffer, recorded into without locking and merged into the registry when the
+ *        thread exits.
+ */
+struct Thread_buffer {
+    std::vector<Record> phases;
+    std::vector<Record> counters;
+    Registry &global = registry();      //< Constructs the registry first so that it outlives the buffer
+
+    ~Thread_buffer() {
+        std::lock_guard<std::mutex> lock{global.mutex};
+        merge(global.phases, phases);
+        merge(global.counters, counters);
+    }
+};
+
+Thread_buffer &buffer() {
+    thread_local Thread_buffer b;
+    return b;
+}
+
+void print_text(const std::vector<Record> &phases, const std::vector<Record> &counters, std::ostream &out) {
+
+    out << "\nPhase report\n"
+        << std::left << std::setw(28) << "phase" << std::right << std::setw(8) << "calls" << std::setw(14)
+        << "total ms" << std::setw(16) << "items" << std::setw(14) << "ns/item" << '\n';
+
+    for (const auto &r : phases) {
+        out << std::left << std::setw(28) << r.name << std::right << std::setw(8) << r.calls << std::setw(14)
+            << std::fixed << std::setprecision(3) << r.ns * 1e-6 << std::setw(16) << r.items << std::setw(14)
+            << (r.items ? static_cast<double>(r.ns) / r.items : 0.0) << '\n';
+    }
+
+    out << std::left << std::setw(28) << "counter" << std::right << std::setw(8) << "calls" << std::setw(14)
+        << "value" << '\n';
+
+    for (const auto &r : counters) {
+        out << std::left << std::setw(28) << r.name << std::right << std::setw(8) << r.calls << std::setw(14)
+            << r.items << '\n';
+    }
+
+    bool any_hw = false;
+    for (const auto &r : phases) {
+        any_hw = any_hw || r.hw_calls > 0;
+    }
+
+    if (any_hw) {
+        out << std::left << std::setw(28) << "hardware counters" << std::right << std::setw(8) << "calls"
+            << std::setw(14) << "IPC" << std::setw(16) << "LLC miss/item" << std::setw(14) << "br miss/item" << '\n';
+
+        for (const auto &r : phases) {
+            if (r.hw_calls == 0) {
+                continue;
+            }
+            double items = r.items ? static_cast<double>(r.items) : 1.0;
+            out << std::left << std::setw(28) << r.name << std::right << std::setw(8) << r.hw_calls
+                << std::setw(14) << std::setprecision(3)
+                << (r.hw[perf_counters::cycles] ? static_cast<double>(r.hw[perf_counters::instructions]) /
+                                                  r.hw[perf_counters::cycles] : 0.0)
+                << std::setw(16) << std::setprecision(5) << r.hw[perf_counters::llc_misses] / items
+                << std::setw(14) << r.hw[perf_counters::branch_misses] / items << '\n';
+        }
+    } else if (hw_compiled_in) {
+        out << std::left << std::setw(28) << "hardware counters" << std::right << std::setw(8) << "-"
+            << std::setw(14) << "unavailable" << '\n';
+    }
+
+    out.unsetf(std::ios_base::floatfield);
+}
+
+void print_json(const std::vector<Record> &phases, const std::vector<Record> &counters, const std::string &filename) {
+
+    std::ofstream outfile(filename);
+
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening phase report " << filename << '\n';
+        return;
+    }
+
+    outfile << "{\n  \"phases\": [\n";
+    for (std::size_t i = 0; i < phases.size(); ++i) {
+        const Record &r = phases[i];
+        outfile << "    {\"name\": \"" << r.name << "\", \"calls\": " << r.calls << ", \"ns\": " << r.ns
+                << ", \"items\": " << r.items;
+        if (r.hw_calls > 0) {
+            outfile << ", \"hw_calls\": " << r.hw_calls;
+            for (int e = 0; e < perf_counters::num_events; ++e) {
+                outfile << ", \"" << perf_counters::event_name(e) << "\": " << r.hw[e];
+            }
+        }
+        outfile << "}" << (i + 1 < phases.size() ? "," : "") << '\n';
+    }
+
+    outfile << "  ],\n  \"counters\": [\n";
+    for (std::size_t i = 0; i < counters.size(); ++i) {
+        const Record &r = counters[i];
+        outfile << "    {\"name\": \"" << r.name << "\", \"calls\": " << r.calls << ", \"value\": " << r.items
+                << "}" << (i + 1 < counters.size() ? "," : "") << '\n';
+    }
+
+    outfile << "  ]\n}\n";
+}
+
+} // namespace
+
+/** \brief      Adds one call of the named phase, taking ns nanoseconds and processing items items.
+*               hw, when given, holds the hardware counter deltas over the call.
+*/
+void record_phase(const char *name, std::int64_t ns, std::int64_t items, const std::int64_t *hw) {
+    Record &r = find(buffer().phases, name);
+    ++r.calls;
+    r.ns += ns;
+    r.items += items;
+    if (hw) {
+        ++r.hw_calls;
+        for (int e = 0; e < perf_counters::num_events; ++e) {
+            r.hw[e] += hw[e];
+        }
+    }
+}
+
+/** \brief      Adds n to the named counter.
+*/
+void count(const char *name, std::int64_t n) {
+    Record &r = find(buffer().counters, name);
+    ++r.calls;
+    r.items += n;
+}
+
+/** \brief      Prints the phase timings and counters merged so far as a text table. Threads
+*               which are still running have not been merged yet.
+*/
+void report(std::ostream &out) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock{reg.mutex};
+    print_text(reg.phases, reg.counters, out);
+}
+
+/** \brief      Writes the phase timings and counters merged so far as JSON.
+*/
+void write_json(const std::string &filename) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock{reg.mutex};
+    print_json(reg.phases, reg.counters, filename);
+}
+
+} // namespace instrument
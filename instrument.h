@@ -0,0 +1,97 @@
+#ifndef INSTRUMENT_H_TPWLXQZE
+#define INSTRUMENT_H_TPWLXQZE
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#ifdef SDE_PERF_COUNTERS
+#include "perf_counters.h"
+#endif
+
+/**
+ * \brief Low-overhead phase timers and counters for the hot paths.
+ *
+ * Instrumentation is compiled in only when SDE_INSTRUMENT is defined (make INSTRUMENT=1). Otherwise the
+ * macros below expand to nothing and cost nothing.
+ *
+ *  SDE_PHASE("scheme.exact", N * ts);     // times the enclosing scope, N * ts items processed
+ *  SDE_COUNT("variates", n);              // adds n to a named counter
+ *
+ * Names must be string literals. Each thread records into its own buffer, without locking, and the
+ * buffers are merged when the thread exits. At program exit a text report is printed to std::cerr and a
+ * JSON report is written to the file named by the SDE_PHASE_REPORT environment variable (default
+ * phase_report.json). Phase times are inclusive of nested phases.
+ *
+ * With SDE_PERF_COUNTERS (make PERF=1) each phase also records the hardware counter deltas of
+ * perf_counters.h, and the report adds IPC and LLC / branch misses per item. For the schemes an item is a
+ * path-step.
+ */
+namespace instrument {
+
+void record_phase(const char *name, std::int64_t ns, std::int64_t items, const std::int64_t *hw = nullptr);
+
+void count(const char *name, std::int64_t n);
+
+void report(std::ostream &out);
+
+void write_json(const std::string &filename);
+
+/**
+ * \brief Times the scope it lives in and records it as one call of a named phase.
+ */
+class Scoped_phase {
+public:
+    Scoped_phase(const char *name, std::int64_t items = 0)
+            : name_{name}, items_{items}, start_{std::chrono::steady_clock::now()} {
+#ifdef SDE_PERF_COUNTERS
+        hw_start_ = perf_counters::read();
+#endif
+    }
+
+    ~Scoped_phase() {
+#ifdef SDE_PERF_COUNTERS
+        perf_counters::Sample hw_end = perf_counters::read();
+#endif
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+#ifdef SDE_PERF_COUNTERS
+        if (hw_start_.valid && hw_end.valid) {
+            std::int64_t hw[perf_counters::num_events];
+            for (int e = 0; e < perf_counters::num_events; ++e) {
+                hw[e] = hw_end.value[e] - hw_start_.value[e];
+            }
+            record_phase(name_, ns.count(), items_, hw);
+            return;
+        }
+#endif
+        record_phase(name_, ns.count(), items_);
+    }
+
+    Scoped_phase(const Scoped_phase &) = delete;
+
+    Scoped_phase &operator=(const Scoped_phase &) = delete;
+
+private:
+    const char *name_;
+    std::int64_t items_;
+    std::chrono::steady_clock::time_point start_;
+#ifdef SDE_PERF_COUNTERS
+    perf_counters::Sample hw_start_;
+#endif
+};
+
+} // namespace instrument
+
+#define SDE_CONCAT_IMPL(a, b) a##b
+#define SDE_CONCAT(a, b) SDE_CONCAT_IMPL(a, b)
+
+#ifdef SDE_INSTRUMENT
+#define SDE_PHASE(...) instrument::Scoped_phase SDE_CONCAT(sde_phase_, __LINE__)(__VA_ARGS__)
+#define SDE_COUNT(name, n) instrument::count(name, static_cast<std::int64_t>(n))
+#else
+#define SDE_PHASE(...) ((void) 0)
+#define SDE_COUNT(name, n) ((void) 0)
+#endif
+
+#endif /* end of include guard: INSTRUMENT_H_TPWLXQZE */
@@ -0,0 +1,185 @@
+#include <valarray>
+#include <vector>
+#include <string>
+#include <utility>
+#include <iostream>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "lazy.h"
+#include "instrument.h"
+
+namespace {
+
+/** \brief      Appends more to the end of v. valarrays cannot grow in place, so v is reallocated.
+*/
+void append(std::valarray<double> &v, const std::valarray<double> &more) {
+
+    std::valarray<double> grown(v.size() + more.size());
+    grown[std::slice(0, v.size(), 1)] = v;
+    grown[std::slice(v.size(), more.size(), 1)] = more;
+    v = std::move(grown);
+}
+
+} // namespace
+
+/** \brief 		Sets up a simulation from its spec without stepping any path. Only the per-step
+*				coefficient table is built here.
+*   \param 		spec - The scheme, parameters, number of paths and steps, variates and observed steps.
+*
+*/
+Lazy_simulation::Lazy_simulation(Simulation_spec spec)
+        : Simulation{spec.params, spec.num_sims, spec.num_timesteps, std::move(spec.observation_steps), false},
+          step_{scheme_step(spec.scheme)}, rng_{spec.rng}, table_{params, num_timesteps()},
+          slices_(observed_steps().size()) {
+
+    std::cout << "Lazy_simulation constructor constructing.\n";
+
+    if (!step_) {
+        std::cerr << "Error. Unknown scheme " << spec.scheme << "." << '\n';
+        exit(1);
+    }
+}
+
+/** \brief 		Steps every path from the last computed step up to step n, keeping the observed
+*				slices and feeding the sinks on the way. Does nothing if n is already computed.
+*   \param 		n - The step to reach, in 0..num_timesteps.
+*
+*/
+void Lazy_simulation::advance_to(int n) {
+
+    if (n > num_timesteps()) {
+        std::cerr << "Error. Time step " << n << " is past the last step " << num_timesteps() << "." << '\n';
+        exit(1);
+    }
+    if (n <= computed_) {
+        return;
+    }
+
+    SDE_PHASE("scheme.lazy", static_cast<std::int64_t>(N) * (n - computed_));
+
+    if (current_.size() == 0) {
+        current_.resize(N, params.S0);
+    }
+    std::valarray<double> rans(N);
+
+    for (int idx = computed_ + 1; idx <= n; ++idx) {
+        rng_.fill(&rans[0], N);
+        step_(current_, rans, table_[idx - 1], delta_t);
+        computed_ = idx;
+
+        if (is_observed(idx)) {
+            slices_[slot(idx)] = current_;
+        }
+        for (const auto &sink : sinks_) {
+            if (sink.first == idx) {
+                sink.second(current_);
+            }
+        }
+    }
+}
+
+/**  \brief     Returns the prices at step n, stepping the paths up to it first if needed.
+*   \param      n . An observed step that is either not computed yet or kept.
+*   \return     valarray<double>& . The N path values at step n.
+*
+*/
+std::valarray<double> &Lazy_simulation::get_valarray_at_step(int n) {
+
+    advance_to(n);
+    std::size_t k = slot(n);
+
+    if (n == 0 && slices_[0].size() == 0) {
+        slices_[0].resize(N, params.S0);
+    }
+    return slices_[k];
+}
+
+/** \brief 		Overwrites the kept prices of step n. Steps after n have already been, or will
+*				be, computed from the simulated prices, not from vals.
+*
+*/
+void Lazy_simulation::insert_valarray_at_step(std::valarray<double> vals, int n) {
+    get_valarray_at_step(n) = std::move(vals);
+}
+
+/** \brief 		Appends count paths to the run. Their variates are drawn from the cursor's current
+*				position, count per step, and they are stepped up to the last computed step, so
+*				the kept slices and the state grow by count values and the sinks of the steps
+*				passed receive the new paths only. Later steps draw N + count variates per step.
+*   \param 		count - The number of paths to add.
+*
+*/
+void Lazy_simulation::add_paths(int count) {
+
+    if (count < 1) {
+        std::cerr << "Error. At least one path must be added." << '\n';
+        exit(1);
+    }
+
+    SDE_PHASE("scheme.lazy.add_paths", static_cast<std::int64_t>(count) * computed_);
+
+    std::valarray<double> prices(params.S0, count);
+    std::valarray<double> rans(count);
+
+    if (slices_[0].size() != 0) {
+        append(slices_[0], prices);
+    }
+
+    for (int idx = 1; idx <= computed_; ++idx) {
+        rng_.fill(&rans[0], count);
+        step_(prices, rans, table_[idx - 1], delta_t);
+
+        if (is_observed(idx)) {
+            append(slices_[slot(idx)], prices);
+        }
+        for (const auto &sink : sinks_) {
+            if (sink.first == idx) {
+                sink.second(prices);
+            }
+        }
+    }
+
+    if (computed_ > 0) {
+        append(current_, prices);
+    }
+    N += count;
+}
+
+/** \brief 		Moves T out by count steps of the same length. Nothing is stepped until a new step
+*				is asked for, when the paths continue from their current state. The new steps are
+*				kept if every step was, otherwise only the new terminal step is.
+*   \param 		count - The number of steps to add.
+*
+*/
+void Lazy_simulation::add_steps(int count) {
+
+    extend_horizon(count);
+    table_ = Step_table{params, num_timesteps()};
+    slices_.resize(observed_steps().size());
+}
+
+/** \brief 		Registers a sink for the prices at step n, so statistics of a step can be taken
+*				without keeping it. A sink for a step already computed is called now if the step
+*				was kept, and is an error otherwise, and stays registered for the paths added later.
+*   \param 		n - The step, in 1..num_timesteps.
+*   \param      sink - Called with the values at step n of each batch of paths that reaches it.
+*
+*/
+void Lazy_simulation::add_sink(int n, Step_sink sink) {
+
+    if (n < 1 || n > num_timesteps()) {
+        std::cerr << "Error. Sink step " << n << " must lie in 1.." << num_timesteps() << "." << '\n';
+        exit(1);
+    }
+    if (n > computed_) {
+        sinks_.emplace_back(n, std::move(sink));
+        return;
+    }
+    if (!is_observed(n)) {
+        std::cerr << "Error. Time step " << n << " has been computed but not kept." << '\n';
+        exit(1);
+    }
+    sink(slices_[slot(n)]);
+    sinks_.emplace_back(n, std::move(sink));
+}
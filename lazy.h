@@ -0,0 +1,78 @@
+#ifndef LAZY_H_TQBNWEHS
+#define LAZY_H_TQBNWEHS
+
+#include <valarray>
+#include <vector>
+#include <string>
+#include <functional>
+#include <iostream>
+
+#include "myrandom.h"
+#include "simulation.h"
+
+/**
+ * \brief A cheap description of a simulation: which scheme to run, on what, and with which variates.
+ */
+struct Simulation_spec {
+    std::string scheme;                     //!< exact, milstein or euler_maruyama
+    Parameters params;
+    int num_sims;
+    int num_timesteps;
+    Variate_cursor rng;                     //!< N variates per step are read from its position on
+    std::vector<int> observation_steps;     //!< The steps to keep, every step when empty
+};
+
+/**
+ * \brief Called with the prices at one step of a batch of paths, as soon as they reach it: every path on the first
+ *        pass, then the paths added by each Lazy_simulation::add_paths().
+ */
+using Step_sink = std::function<void(const std::valarray<double> &)>;
+
+/**
+ * \brief Simulation that only steps its paths when a result is asked for.
+ *
+ * Construction stores the spec and the coefficient table, nothing else. get_valarray_at_step(n) steps every
+ * path from the last computed step up to n, keeping the observed slices it passes, and step sinks receive
+ * the prices of their step on the way, whether or not it is kept. Steps after the last one asked for are
+ * never computed and slices are only allocated when they are reached. Steps can only be read in the order
+ * they are computed: a step that has been passed without being kept is an error.
+ *
+ * A run can be extended in place. add_paths() appends paths, drawing their variates from where the cursor
+ * stands and catching them up to the last computed step. add_steps() moves T out by more steps, which are
+ * computed from the current state when asked for. Sinks stay registered, so each one receives the new paths
+ * at its step once they get there, and running statistics or histograms fed by sinks update without
+ * revisiting the earlier paths. Both invalidate references returned by get_valarray_at_step().
+ */
+class Lazy_simulation : public Simulation {
+public:
+    explicit Lazy_simulation(Simulation_spec spec);
+
+    ~Lazy_simulation() {
+        std::cout << "Lazy_simulation destructor" << std::endl;
+    };
+
+    std::valarray<double> &get_valarray_at_step(int n) override;
+
+    void insert_valarray_at_step(std::valarray<double> vals, int n) override;
+
+    void add_sink(int n, Step_sink sink);
+
+    void advance_to(int n);
+
+    void add_paths(int count);
+
+    void add_steps(int count);
+
+    int steps_computed() const { return computed_; }
+
+private:
+    Step_function step_;
+    Variate_cursor rng_;
+    Step_table table_;
+    int computed_ = 0;                                  //!< Last step computed, held in current_
+    std::valarray<double> current_;                     //!< Empty until the first step is computed
+    std::vector<std::valarray<double>> slices_;         //!< One per observed step, empty until reached
+    std::vector<std::pair<int, Step_sink>> sinks_;
+};
+
+#endif /* end of include guard: LAZY_H_TQBNWEHS */
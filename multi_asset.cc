@@ -0,0 +1,91 @@
+#include <vector>
+#include <valarray>
+#include <utility>
+#include <iostream>
+#include <cmath>
+
+#include "simulation.h"
+#include "multi_asset.h"
+
+/** \brief 		Checks that every asset has the same time horizon and factorises the correlation
+*				matrix as L L^T.
+*   \param 		assets - The parameters of each asset. t0 and T must agree.
+*   \param      correlation - The correlation matrix, row-major num_assets x num_assets. It must be
+*				symmetric positive definite with a unit diagonal.
+*
+*/
+Correlated_assets::Correlated_assets(std::vector<Parameters> assets, const std::vector<double> &correlation)
+        : assets_(std::move(assets)), chol_(correlation.size(), 0.0) {
+
+    int d = num_assets();
+
+    if (d == 0 || correlation.size() != static_cast<std::size_t>(d) * d) {
+        std::cerr << "Error. The correlation matrix must be " << d << " x " << d << "." << '\n';
+        exit(1);
+    }
+
+    for (const auto &p : assets_) {
+        if (p.t0 != assets_[0].t0 || p.T != assets_[0].T) {
+            std::cerr << "Error. All assets must share t0 and T." << '\n';
+            exit(1);
+        }
+    }
+
+    for (int i = 0; i < d; ++i) {
+        for (int j = 0; j <= i; ++j) {
+            if (correlation[i * d + j] != correlation[j * d + i]) {
+                std::cerr << "Error. The correlation matrix is not symmetric." << '\n';
+                exit(1);
+            }
+            double sum = correlation[i * d + j];
+            for (int k = 0; k < j; ++k) {
+                sum -= chol_[i * d + k] * chol_[j * d + k];
+            }
+            if (i == j) {
+                if (sum <= 0) {
+                    std::cerr << "Error. The correlation matrix is not positive definite." << '\n';
+                    exit(1);
+                }
+                chol_[i * d + i] = std::sqrt(sum);
+            } else {
+                chol_[i * d + j] = sum / chol_[j * d + j];
+            }
+        }
+    }
+}
+
+/** \brief 		Correlates the normal variates of one time step of a block of paths.
+*   \param 		z - d*n independent standard normals, asset-major: z[a*n + i] is asset a of path i.
+*   \param      n - The number of paths in the block.
+*   \param      out - d valarrays of size n, overwritten with out[a] = sum_b L[a][b] * z[b].
+*
+*/
+void Correlated_assets::correlate(const double *z, int n, std::vector<std::valarray<double>> &out) const {
+
+    int d = num_assets();
+
+    for (int a = 0; a < d; ++a) {
+        double *y = &out[a][0];
+        const double *row = &chol_[a * d];
+        for (int i = 0; i < n; ++i) {
+            y[i] = row[0] * z[i];
+        }
+        for (int b = 1; b <= a; ++b) {
+            const double *zb = z + static_cast<std::size_t>(b) * n;
+            double l = row[b];
+            for (int i = 0; i < n; ++i) {
+                y[i] += l * zb[i];
+            }
+        }
+    }
+}
+
+/** \brief      The num_assets x num_assets correlation matrix with every off-diagonal equal to rho.
+*/
+std::vector<double> constant_correlation(int num_assets, double rho) {
+    std::vector<double> corr(static_cast<std::size_t>(num_assets) * num_assets, rho);
+    for (int a = 0; a < num_assets; ++a) {
+        corr[a * num_assets + a] = 1.0;
+    }
+    return corr;
+}
@@ -0,0 +1,36 @@
+#ifndef MULTI_ASSET_H_TRKZFMUA
+#define MULTI_ASSET_H_TRKZFMUA
+
+#include <vector>
+#include <valarray>
+
+#include "simulation.h"
+
+/**
+ * \brief A set of correlated GBM assets: the parameters of each asset and the Cholesky factor of their
+ *        correlation matrix, factorised once on construction.
+ *
+ * Paths are held asset-major, one valarray per asset over a block of paths, so the correlation transform of a
+ * time step is a lower-triangular matrix times a block of normal vectors whose inner loop runs over contiguous
+ * paths, and every asset is then advanced by an unchanged single-asset step function.
+ */
+class Correlated_assets {
+public:
+    Correlated_assets(std::vector<Parameters> assets, const std::vector<double> &correlation);
+
+    int num_assets() const { return static_cast<int>(assets_.size()); }
+
+    const Parameters &asset(int a) const { return assets_[a]; }
+
+    void correlate(const double *z, int n, std::vector<std::valarray<double>> &out) const;
+
+    const std::vector<double> &cholesky_factor() const { return chol_; }
+
+private:
+    std::vector<Parameters> assets_;
+    std::vector<double> chol_;      //!< Lower-triangular Cholesky factor, row-major num_assets x num_assets
+};
+
+std::vector<double> constant_correlation(int num_assets, double rho);
+
+#endif /* end of include guard: MULTI_ASSET_H_TRKZFMUA */
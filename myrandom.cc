@@ -12,6 +12,8 @@
 #include <boost/random/variate_generator.hpp>
 
 #include "myrandom.h"
+#include "placement.h"
+#include "instrument.h"
 #include "sobol.h"
 
 /**  \brief     Default constructor for class Gaussian_RNs. This function accepts one
@@ -41,6 +43,54 @@ Gaussian_RNs::Gaussian_RNs(int n) : N_{n} {
                   std::end(random_data), std::ref(rand));
     std::seed_seq seeds(std::begin(random_data),
                         std::end(random_data));
+
+    fill(seeds);
+}
+
+/**  \brief     Constructor for a deterministic set of n Gaussian variates. The Mersenne Twister
+*               is seeded from seed alone, so two objects built with the same n and seed hold
+*               the same variates.
+*   \param      n . The number of random variates generated.
+*   \param      seed . The seed for the Mersenne Twister rng.
+*
+*/
+Gaussian_RNs::Gaussian_RNs(int n, std::uint64_t seed) : N_{n} {
+
+    std::seed_seq seeds{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+
+    fill(seeds);
+}
+
+/**  \brief     As Gaussian_RNs(n, seed), with the same variates, for a pool that the workers of a
+*               scheduler will read paths_per_step variates per step of, Block_stream block by block.
+*               The pool is first touched by those workers (first_touch()) before it is filled, so
+*               each page is placed on the NUMA node of the worker that reads it. The Mersenne
+*               Twister is one sequential stream, so the fill itself stays on the calling thread.
+*   \param      n . seed . As above.
+*   \param      paths_per_step . The number of paths of the runs that read the pool.
+*   \param      scheduler . The workers that will read the pool.
+*
+*/
+Gaussian_RNs::Gaussian_RNs(int n, std::uint64_t seed, int paths_per_step, Scheduler &scheduler) : N_{n} {
+
+    std::seed_seq seeds{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+
+    if (paths_per_step < 1) {
+        std::cerr << "Error. A pool needs at least one path per step." << '\n';
+        exit(1);
+    }
+    data_.resize(N_);
+    first_touch(data_.data(), paths_per_step, scheduler, N_ / paths_per_step);
+    fill(seeds);
+}
+
+/**  \brief     Fills data with N_ Gaussian variates from a Mersenne Twister seeded by seeds.
+*
+*/
+void Gaussian_RNs::fill(std::seed_seq &seeds) {
+
+    SDE_PHASE("rng.mt19937_64", N_);
+
     std::mt19937_64 seeded_engine(seeds);
 
     // Bind Normal probability density function to Mersenne Twister to generate Gaussian variates
@@ -51,9 +101,20 @@ Gaussian_RNs::Gaussian_RNs(int n) : N_{n} {
 
     // Populate data vector with Gaussian variates.
     std::generate(std::begin(data_), std::end(data_), gen);
+    SDE_COUNT("variates_drawn", N_);
+    SDE_COUNT("bytes_allocated", N_ * sizeof(double));
 }
 
 
+/**  \brief     Constructor taking variates that were generated elsewhere, e.g. Brownian increments
+*               summed down to a coarser time grid. They are handed out by operator()() in order.
+*   \param      variates . The standard normal variates to hold, moved in rather than copied.
+*
+*/
+Gaussian_RNs::Gaussian_RNs(Path_vector<double> variates)
+        : N_{static_cast<int>(variates.size())}, data_(std::move(variates)) {}
+
+
 /**  \brief     This function overloads the function call operator for this class. When
 *               an object of this type is called as a function object (functor), it should
 *               return the next unused Gaussian variate from data. If all the Gaussian
@@ -87,6 +148,89 @@ void Gaussian_RNs::reset_to_start() const {
     *cur_idx_ = 0;
 }
 
+/**  \brief     Skips the next n variates, as n calls to operator()() would, wrapping around
+*               to the start of data when it runs out.
+*   \param      n . The number of variates to skip.
+*
+*/
+void Gaussian_RNs::advance(long n) const {
+    *cur_idx_ = static_cast<int>((*cur_idx_ + n) % N_);
+}
+
+/**  \brief     Returns a cursor of its own over these variates, starting at index start. Its
+*               position is independent of this object's and of every other cursor.
+*   \param      start . The index in data of the first variate the cursor returns.
+*   \return     Variate_cursor . The new cursor.
+*
+*/
+Variate_cursor Gaussian_RNs::cursor(int start) const {
+    return Variate_cursor{*this, start};
+}
+
+/**  \brief     Constructs a cursor over pool, starting at index start.
+*
+*/
+Variate_cursor::Variate_cursor(const Gaussian_RNs &pool, int start) : pool_{&pool}, start_{start}, pos_{start} {
+
+    if (start < 0 || start > pool.size()) {
+        std::cerr << "Error. Cursor start " << start << " is outside the pool of " << pool.size() << " variates."
+                  << '\n';
+        exit(1);
+    }
+}
+
+/**  \brief     Returns the next variate of the pool, wrapping around to its start as
+*               Gaussian_RNs::operator()() does.
+*
+*/
+double Variate_cursor::operator()() {
+
+    if (pos_ == pool_->size()) {
+        pos_ = 0;
+    }
+    return pool_->data()[pos_++];
+}
+
+/**  \brief     Writes the next n variates to out, in contiguous runs between wrap-arounds.
+*
+*/
+void Variate_cursor::fill(double *out, int n) {
+
+    while (n > 0) {
+        if (pos_ == pool_->size()) {
+            pos_ = 0;
+        }
+        int len = std::min(n, pool_->size() - pos_);
+        std::copy(pool_->data() + pos_, pool_->data() + pos_ + len, out);
+        pos_ += len;
+        out += len;
+        n -= len;
+    }
+}
+
+/**  \brief     Skips the next n variates, as n calls to operator()() would.
+*
+*/
+void Variate_cursor::advance(long n) {
+    pos_ = static_cast<int>((pos_ + n) % pool_->size());
+}
+
+/**  \brief     Reserves the next n variates of the pool with one atomic fetch-add. The block is
+*               short at the end of the pool and empty once it is used up.
+*   \param      n . The number of variates wanted.
+*   \return     Variate_block . The reserved variates and their index in the pool.
+*
+*/
+Variate_block Shared_stream::reserve(int n) {
+
+    long first = next_.fetch_add(n, std::memory_order_relaxed);
+    if (first >= pool_->size()) {
+        return Variate_block{nullptr, first, 0};
+    }
+    int size = static_cast<int>(std::min<long>(n, pool_->size() - first));
+    return Variate_block{pool_->data() + first, first, size};
+}
+
 
 /** \brief          This constructor generates N Gaussian variates using BOOST's lagged Fibonacci
  *                  random number generator. The rng is benchmarked on boost.org as the fastest rng
@@ -96,7 +240,9 @@ void Gaussian_RNs::reset_to_start() const {
  *  \param n        The number of random variates
  *
  */
-BOOST_Fibonacci::BOOST_Fibonacci(int n) : Gaussian_RNs{n} {
+BOOST_Fibonacci::BOOST_Fibonacci(int n) : Gaussian_RNs{Path_vector<double>(n)} {
+
+    SDE_PHASE("rng.lagged_fibonacci", n);
 
     data_.resize(N_);    //!< Resize vector for N_ variates
 
@@ -118,6 +264,8 @@ BOOST_Fibonacci::BOOST_Fibonacci(int n) : Gaussian_RNs{n} {
             boost::normal_distribution<>> gen(rng, std_norm);
 
     std::generate(std::begin(data_), std::end(data_), gen);
+    SDE_COUNT("variates_drawn", N_);
+    SDE_COUNT("bytes_allocated", N_ * sizeof(double));
 }
 
 /** \brief          This constructor generates N Gaussian variates using Sobol's quasi random number
@@ -127,18 +275,20 @@ BOOST_Fibonacci::BOOST_Fibonacci(int n) : Gaussian_RNs{n} {
  *  \param seed     The seed for the rng
  *
  */
-Sobol::Sobol(int n) : Gaussian_RNs{n} {
+Sobol::Sobol(int n) : Gaussian_RNs{Path_vector<double>(n)} {
 
     if (N_ > 10'000) {
         std::cerr << "Error. Number of Gaussian variates is too large for Sobol sequence efficacy." << '\n';
         exit(1);
     }
 
+    SDE_PHASE("rng.sobol", n);
+
     // Resize vector for N_ variates
     data_.resize(N_);
 
     // Copy N_ elements of the sobol array into the data_ vector and inverse transform them
-    std::transform(std::begin(sobol), std::end(sobol), std::begin(data_), [](const double &x) {
+    std::transform(std::begin(sobol), std::begin(sobol) + N_, std::begin(data_), [](const double &x) {
         return boost::math::erf_inv((2 * x) - 1) * std::sqrt(2);
     });
 
@@ -148,4 +298,30 @@ Sobol::Sobol(int n) : Gaussian_RNs{n} {
 
     // Sobol numbers need to be shuffled to achieve good results
     std::shuffle(std::begin(data_), std::end(data_), g);
+    SDE_COUNT("variates_drawn", N_);
+    SDE_COUNT("bytes_allocated", N_ * sizeof(double));
+}
+
+/** \brief          Restarts the stream at the first variate of a block of paths.
+ *  \param seed     The seed of the run
+ *  \param block    The index of the block of paths
+ *
+ */
+void Block_stream::seek(std::uint64_t seed, long block) {
+
+    std::seed_seq seeds{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32),
+                        static_cast<std::uint32_t>(block), static_cast<std::uint32_t>(static_cast<std::uint64_t>(block) >> 32)};
+    engine_.seed(seeds);
+    dist_.reset();
+}
+
+/** \brief          Writes the next n Gaussian variates of the block to out.
+ *
+ */
+void Block_stream::fill(double *out, int n) {
+
+    for (int i = 0; i < n; ++i) {
+        out[i] = dist_(engine_);
+    }
+    SDE_COUNT("variates_drawn", n);
 }
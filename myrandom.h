@@ -4,26 +4,123 @@
 #include <vector>        //< std::vector
 #include <memory>        //<
 #include <algorithm>
+#include <random>
+#include <cstdint>
+#include <atomic>
+
+#include "placement.h"
+
+class Variate_cursor;
 
 /**
  * \brief Class to generate and store normally distributed random numbers
+ *
+ * operator()() and reset_to_start() move one cursor shared by every holder (and copy) of the object, so
+ * two consumers of the same instance interfere. Consumers that may run together should each take their
+ * own cursor() or share the pool through a Shared_stream instead.
  */
 class Gaussian_RNs {
 public:
     Gaussian_RNs(int n);
 
+    Gaussian_RNs(int n, std::uint64_t seed);
+
+    Gaussian_RNs(int n, std::uint64_t seed, int paths_per_step, Scheduler &scheduler);
+
+    explicit Gaussian_RNs(Path_vector<double> variates);
+
     double operator()() const;
 
     void reset_to_start() const;
 
+    int position() const { return *cur_idx_; }              //!< Index in data() of the next variate
+
+    void advance(long n) const;
+
+    Variate_cursor cursor(int start = 0) const;
+
+    const double *data() const { return data_.data(); }     //!< The stored variates, in draw order
+
+    int size() const { return N_; }
+
 protected:
+    void fill(std::seed_seq &seeds);
+
     int N_;
-    std::vector<double> data_;
+    Path_vector<double> data_;      //!< Huge pages when large, see Path_allocator
     std::shared_ptr<int> cur_idx_ = std::make_shared<int>(0);
 
 };
 
 
+/**
+ *
+ *  \brief         An independent cursor over the variates of a Gaussian_RNs pool.
+ *
+ *  Each cursor has its own position, so any number of cursors may read one pool, on any threads, and
+ *  rewinding one affects no other. Like Gaussian_RNs it wraps around to the start of the pool when the
+ *  variates run out. The pool must outlive its cursors.
+ *
+ */
+class Variate_cursor {
+public:
+    explicit Variate_cursor(const Gaussian_RNs &pool, int start = 0);
+
+    double operator()();
+
+    void fill(double *out, int n);
+
+    void advance(long n);
+
+    void reset_to_start() { pos_ = start_; }                //!< Back to the position the cursor started at
+
+    int position() const { return pos_; }
+
+    const Gaussian_RNs &pool() const { return *pool_; }
+
+private:
+    const Gaussian_RNs *pool_;
+    int start_;
+    int pos_;
+};
+
+/**
+ *
+ *  \brief         A contiguous run of variates reserved from a Shared_stream.
+ *
+ */
+struct Variate_block {
+    const double *data;     //!< The variates, nullptr once the pool is exhausted
+    long first;             //!< Index in the pool of data[0], which identifies the block
+    int size;               //!< Number of variates, 0 once the pool is exhausted
+};
+
+/**
+ *
+ *  \brief         Hands out disjoint blocks of one Gaussian_RNs pool to concurrent consumers.
+ *
+ *  reserve() claims the next variates with one atomic fetch-add and takes no lock, so threads draining
+ *  a pool never wait on each other. Each variate goes to exactly one consumer and, unlike Gaussian_RNs,
+ *  the stream does not wrap: once the pool is used up every reserve() returns an empty block.
+ *
+ */
+class Shared_stream {
+public:
+    explicit Shared_stream(const Gaussian_RNs &pool) : pool_{&pool} {}
+
+    Shared_stream(const Shared_stream &) = delete;
+
+    Shared_stream &operator=(const Shared_stream &) = delete;
+
+    Variate_block reserve(int n);
+
+    void reset_to_start() { next_.store(0, std::memory_order_relaxed); }   //!< Not safe during reserve()
+
+private:
+    const Gaussian_RNs *pool_;
+    std::atomic<long> next_{0};
+};
+
 /**
  *
  *  \brief         A simple class used to hold data for Gaussian variates using
@@ -50,4 +147,26 @@ public:
     ~Sobol() {};
 };
 
+/**
+ *
+ *  \brief         Gaussian variates for one block of paths, reproducible from (seed, block).
+ *
+ *  Each block of paths has its own Mersenne Twister stream seeded from the run seed and the block
+ *  index, so a block gives the same variates whichever thread simulates it and in whatever order. A
+ *  worker keeps one Block_stream and seeks it to each block it picks up.
+ *
+ */
+class Block_stream {
+public:
+    static constexpr int paths_per_block = 4096;     //!< Paths sharing one stream
+
+    void seek(std::uint64_t seed, long block);
+
+    void fill(double *out, int n);
+
+private:
+    std::mt19937_64 engine_;
+    std::normal_distribution<double> dist_{0, 1.0};
+};
+
 #endif /* end of include guard: RANDOM_H_ZORMJADF */
@@ -0,0 +1,577 @@
+#include <valarray>
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <sstream>
+#include <iostream>
+#include <cmath>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "multi_asset.h"
+#include "empirical.h"
+#include "payoff.h"
+#include "scheduler.h"
+#include "instrument.h"
+
+namespace {
+
+/** \brief      max(S - K, 0) for a call, max(K - S, 0) for a put, elementwise.
+*/
+std::valarray<double> intrinsic(Option_type type, const std::valarray<double> &S, double K) {
+    std::valarray<double> out(S.size());
+    for (std::size_t i = 0; i < S.size(); ++i) {
+        out[i] = std::max(type == Option_type::call ? S[i] - K : K - S[i], 0.0);
+    }
+    return out;
+}
+
+/** \brief      Steps n paths from t0 to T, updating the accumulators the payoff asks for after
+*               every step, and adds their discounted payoffs to stats. Only the current prices,
+*               the variates of one step and the accumulators are held, never the grid. draw(out, n)
+*               writes the n variates of the next step to out. The coefficients of step k are
+*               table[k].
+*/
+template <typename Draw>
+void price_paths(const Payoff &payoff, Step_function step, const Parameters &p, const Step_table &table, int n,
+                 int ts, Draw draw, Running_stats &stats) {
+
+    SDE_PHASE("payoff.paths", static_cast<long>(n) * ts);
+
+    double delta_t = (p.T - p.t0) / ts;
+    std::valarray<double> prices(p.S0, n);
+    std::valarray<double> rans(n);
+    Path_accumulators acc{payoff.accumulators(), n, p.S0};
+
+    for (int k = 0; k < ts; ++k) {
+        draw(&rans[0], n);
+        step(prices, rans, table[k], delta_t);
+        acc.observe(prices);
+    }
+
+    stats.add(payoff.value(prices, acc) * table.discount_factor());
+}
+
+/** \brief      Steps n paths of every asset from t0 to T and prices the payoff on the basket level
+*               sum_a weights[a] * S_a, whose accumulators are updated after every step. Each step
+*               draws d*n variates, correlates them and advances each asset with the single-asset
+*               step, using the step table of that asset. Only the current prices of the block are
+*               held.
+*/
+template <typename Draw>
+void basket_paths(const Payoff &payoff, const Correlated_assets &assets, const std::vector<Step_table> &tables,
+                  const std::valarray<double> &weights, Step_function step, int n, int ts, Draw draw,
+                  Running_stats &stats) {
+
+    int d = assets.num_assets();
+    SDE_PHASE("payoff.basket_paths", static_cast<long>(n) * ts * d);
+
+    const Parameters &p = assets.asset(0);
+    double delta_t = (p.T - p.t0) / ts;
+    std::vector<double> z(static_cast<std::size_t>(d) * n);
+    std::vector<std::valarray<double>> prices;
+    std::vector<std::valarray<double>> correlated(d, std::valarray<double>(n));
+    std::valarray<double> basket(n);
+    double basket_S0 = 0;
+
+    for (int a = 0; a < d; ++a) {
+        prices.emplace_back(assets.asset(a).S0, n);
+        basket_S0 += weights[a] * assets.asset(a).S0;
+    }
+    Path_accumulators acc{payoff.accumulators(), n, basket_S0};
+
+    for (int k = 0; k < ts; ++k) {
+        draw(z.data(), d * n);
+        assets.correlate(z.data(), n, correlated);
+        basket = 0.0;
+        for (int a = 0; a < d; ++a) {
+            step(prices[a], correlated[a], tables[a][k], delta_t);
+            basket += weights[a] * prices[a];
+        }
+        acc.observe(basket);
+    }
+
+    stats.add(payoff.value(basket, acc) * tables[0].discount_factor());
+}
+
+/** \brief      "call K=<strike>" or "put K=<strike>", with the strike in hexadecimal floating point.
+*/
+std::string option_key(Option_type type, double strike) {
+    std::stringstream ss;
+    ss << (type == Option_type::call ? "call" : "put") << " K=" << std::hexfloat << strike;
+    return ss.str();
+}
+
+/** \brief      The exact description of a single-asset run, for its checkpoint: the engine and its
+*               options, the payoff, the scheme, the number of steps and the parameters.
+*/
+std::string run_key(const std::string &engine, const Payoff &payoff, const std::string &scheme, int ts,
+                    const Parameters &p) {
+    return engine + " | " + payoff.key() + " | scheme=" + scheme + " ts=" + std::to_string(ts) + " | " +
+           parameters_key(p);
+}
+
+/**
+ * \brief Streaming statistics of the discounted payoffs and of the per-path sensitivity estimates.
+ */
+struct Greek_stats {
+    Running_stats price;
+    Running_stats delta;
+    Running_stats gamma;
+    Running_stats vega;
+    bool pathwise = false;      //!< Whether delta and vega came from pathwise derivatives
+
+    void merge(const Greek_stats &other) {
+        price.merge(other.price);
+        delta.merge(other.delta);
+        gamma.merge(other.gamma);
+        vega.merge(other.vega);
+        pathwise = pathwise || other.pathwise;
+    }
+};
+
+/** \brief      Prices n paths as price_paths() and, in the same pass, estimates delta, gamma and
+*               vega. Delta and vega are pathwise when the payoff has a pathwise derivative:
+*               dS/dS0 = S/S0 for all three schemes and dS/dsigma is propagated by the scheme's
+*               sigma tangent. Otherwise, and for gamma, the exact scheme uses the likelihood ratio
+*               scores of its lognormal transitions: for S0 only the first step depends on it, for
+*               sigma every step does. Gamma of a payoff with a pathwise delta is the mixed
+*               estimator E[delta_pw * (score - 1/S0)]. The Euler-Maruyama and Milstein transition
+*               densities are not used, so those schemes give no gamma and no barrier Greeks.
+*/
+template <typename Draw>
+void greek_paths(const Payoff &payoff, Step_function step, Tangent_function tangent, bool exact, const Parameters &p,
+                 const Step_table &table, int n, int ts, Draw draw, Greek_stats &stats) {
+
+    SDE_PHASE("payoff.greek_paths", static_cast<long>(n) * ts);
+
+    double delta_t = (p.T - p.t0) / ts;
+    double root_delta_t = std::sqrt(delta_t);
+    double sd = table[0].sigma * root_delta_t;                  //< sd of the log-return of the first step
+    double df = table.discount_factor();
+    bool averaged = payoff.accumulators() & Path_accumulators::average;
+
+    bool pathwise = payoff.has_pathwise();
+
+    std::valarray<double> prices(p.S0, n);
+    std::valarray<double> rans(n);
+    std::valarray<double> z(n);
+    std::valarray<double> d_sigma(0.0, pathwise ? n : 0);      //< dS/dsigma at the current step
+    std::valarray<double> d_sigma_sum(0.0, pathwise && averaged ? n : 0);
+    std::valarray<double> delta_score(exact ? n : 0);
+    std::valarray<double> gamma_score(exact ? n : 0);
+    std::valarray<double> vega_score(0.0, exact && !pathwise ? n : 0);
+    Path_accumulators acc{payoff.accumulators(), n, p.S0};
+
+    for (int k = 0; k < ts; ++k) {
+        draw(&rans[0], n);
+        z = rans;
+        if (pathwise) {
+            tangent(prices, d_sigma, z, table[k], delta_t);
+        }
+        step(prices, rans, table[k], delta_t);
+        acc.observe(prices);
+
+        if (pathwise && averaged) {
+            d_sigma_sum += d_sigma;
+        }
+        if (exact && k == 0) {
+            delta_score = z / (p.S0 * sd);
+            gamma_score = (z * z - 1.0 - sd * z) / (sd * sd * p.S0 * p.S0);
+        }
+        if (exact && !pathwise) {
+            vega_score += (z * z - 1.0) / table[k].sigma - z * root_delta_t;
+        }
+    }
+
+    std::valarray<double> value = payoff.value(prices, acc) * df;
+    stats.price.add(value);
+
+    if (pathwise) {
+        std::valarray<double> pw_delta;
+        std::valarray<double> pw_vega;
+        std::valarray<double> d_average = averaged ? acc.average_price() / p.S0 : std::valarray<double>();
+        payoff.pathwise(prices, acc, prices / p.S0, d_average, pw_delta);
+        payoff.pathwise(prices, acc, d_sigma, averaged ? d_sigma_sum / static_cast<double>(ts) : d_average, pw_vega);
+        pw_delta *= df;
+        stats.delta.add(pw_delta);
+        stats.vega.add(pw_vega * df);
+        if (exact) {
+            stats.gamma.add(pw_delta * (delta_score - 1.0 / p.S0));
+        }
+        stats.pathwise = true;
+    } else if (exact) {
+        stats.delta.add(value * delta_score);
+        stats.gamma.add(value * gamma_score);
+        stats.vega.add(value * vega_score);
+    }
+}
+
+/** \brief      Prices n paths at the base parameters and at S0 +- h_S0 and sigma +- h_sigma (in
+*               that order in bumped, with their step tables), all driven by the same variates
+*               (common random numbers), and adds the per-path central differences to the delta,
+*               gamma and vega statistics.
+*/
+template <typename Draw>
+void bumped_paths(const Payoff &payoff, Step_function step, const std::vector<Parameters> &bumped,
+                  const std::vector<Step_table> &tables, double h_S0, double h_sigma, int n, int ts, Draw draw,
+                  Greek_stats &stats) {
+
+    SDE_PHASE("payoff.bumped_paths", 5L * n * ts);
+
+    const Parameters &p = bumped[0];
+    double delta_t = (p.T - p.t0) / ts;
+    double df = tables[0].discount_factor();
+    std::valarray<double> rans(n);
+    std::valarray<double> scratch(n);
+    std::vector<std::valarray<double>> prices;
+    std::vector<Path_accumulators> acc;
+    for (const auto &b : bumped) {
+        prices.emplace_back(b.S0, n);
+        acc.emplace_back(payoff.accumulators(), n, b.S0);
+    }
+
+    for (int k = 0; k < ts; ++k) {
+        draw(&rans[0], n);
+        for (std::size_t j = 0; j < bumped.size(); ++j) {
+            scratch = rans;
+            step(prices[j], scratch, tables[j][k], delta_t);
+            acc[j].observe(prices[j]);
+        }
+    }
+
+    std::vector<std::valarray<double>> value;
+    for (std::size_t j = 0; j < bumped.size(); ++j) {
+        value.push_back(payoff.value(prices[j], acc[j]) * df);
+    }
+    stats.price.add(value[0]);
+    stats.delta.add((value[1] - value[2]) / (2 * h_S0));
+    stats.gamma.add((value[1] - 2.0 * value[0] + value[2]) / (h_S0 * h_S0));
+    stats.vega.add((value[3] - value[4]) / (2 * h_sigma));
+}
+
+Pricing_result result_from(const Running_stats &stats) {
+    return Pricing_result{stats.mean(), std::sqrt(stats.variance() / stats.count()), stats};
+}
+
+Sensitivity sensitivity_from(const Running_stats &stats, const std::string &method) {
+    if (stats.count() == 0) {
+        return Sensitivity{};
+    }
+    return Sensitivity{stats.mean(), std::sqrt(stats.variance() / stats.count()), method};
+}
+
+/** \brief      Checks a scheme name, as the Greeks need both its step and its sigma tangent.
+*/
+void check_scheme(const std::string &scheme) {
+    if (!scheme_step(scheme)) {
+        std::cerr << "Error. Unknown scheme " << scheme << "." << '\n';
+        exit(1);
+    }
+}
+
+/** \brief      Standard normal cumulative distribution function.
+*/
+double norm_cdf(double x) {
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+} // namespace
+
+Path_accumulators::Path_accumulators(unsigned which, int n, double S0) : which_(which) {
+    if (which_ & average) {
+        sum_.resize(n, 0.0);
+    }
+    if (which_ & minimum) {
+        min_.resize(n, S0);
+    }
+    if (which_ & maximum) {
+        max_.resize(n, S0);
+    }
+}
+
+/** \brief      Folds the prices of one time step into the accumulators.
+*/
+void Path_accumulators::observe(const std::valarray<double> &prices) {
+    ++num_obs_;
+    if (which_ & average) {
+        sum_ += prices;
+    }
+    if (which_ & minimum) {
+        for (std::size_t i = 0; i < prices.size(); ++i) {
+            min_[i] = std::min(min_[i], prices[i]);
+        }
+    }
+    if (which_ & maximum) {
+        for (std::size_t i = 0; i < prices.size(); ++i) {
+            max_[i] = std::max(max_[i], prices[i]);
+        }
+    }
+}
+
+std::string European::key() const {
+    return "european " + option_key(type_, strike_);
+}
+
+std::valarray<double> European::value(const std::valarray<double> &terminal, const Path_accumulators &) const {
+    return intrinsic(type_, terminal, strike_);
+}
+
+void European::pathwise(const std::valarray<double> &terminal, const Path_accumulators &,
+                        const std::valarray<double> &d_terminal, const std::valarray<double> &,
+                        std::valarray<double> &out) const {
+    out.resize(terminal.size());
+    for (std::size_t i = 0; i < terminal.size(); ++i) {
+        bool call = type_ == Option_type::call;
+        bool in_the_money = call ? terminal[i] > strike_ : terminal[i] < strike_;
+        out[i] = in_the_money ? (call ? d_terminal[i] : -d_terminal[i]) : 0.0;
+    }
+}
+
+std::string Asian::key() const {
+    return "asian " + option_key(type_, strike_);
+}
+
+std::valarray<double> Asian::value(const std::valarray<double> &, const Path_accumulators &acc) const {
+    return intrinsic(type_, acc.average_price(), strike_);
+}
+
+void Asian::pathwise(const std::valarray<double> &, const Path_accumulators &acc, const std::valarray<double> &,
+                     const std::valarray<double> &d_average, std::valarray<double> &out) const {
+    std::valarray<double> average = acc.average_price();
+    out.resize(average.size());
+    for (std::size_t i = 0; i < average.size(); ++i) {
+        bool call = type_ == Option_type::call;
+        bool in_the_money = call ? average[i] > strike_ : average[i] < strike_;
+        out[i] = in_the_money ? (call ? d_average[i] : -d_average[i]) : 0.0;
+    }
+}
+
+std::string Barrier::key() const {
+    const char *names[] = {"up_and_out", "up_and_in", "down_and_out", "down_and_in"};
+    std::stringstream ss;
+    ss << "barrier " << names[static_cast<int>(barrier_)] << ' ' << option_key(type_, strike_) << " level="
+       << std::hexfloat << level_;
+    return ss.str();
+}
+
+unsigned Barrier::accumulators() const {
+    bool up = barrier_ == Barrier_type::up_and_out || barrier_ == Barrier_type::up_and_in;
+    return up ? Path_accumulators::maximum : Path_accumulators::minimum;
+}
+
+/** \brief      The intrinsic value at T of the paths that are alive: for a knock-out those that
+*               never touched the barrier, for a knock-in those that did.
+*/
+std::valarray<double> Barrier::value(const std::valarray<double> &terminal, const Path_accumulators &acc) const {
+    bool up = barrier_ == Barrier_type::up_and_out || barrier_ == Barrier_type::up_and_in;
+    bool knock_in = barrier_ == Barrier_type::up_and_in || barrier_ == Barrier_type::down_and_in;
+    const std::valarray<double> &extreme = up ? acc.running_max() : acc.running_min();
+
+    std::valarray<double> out = intrinsic(type_, terminal, strike_);
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        bool hit = up ? extreme[i] >= level_ : extreme[i] <= level_;
+        if (hit != knock_in) {
+            out[i] = 0;
+        }
+    }
+    return out;
+}
+
+/** \brief 		Prices an option in one pass over the time steps. The path-dependent accumulators
+*				are updated inside the time loop, so memory is O(N) whatever the number of steps.
+*				Payoffs are discounted at mu, the drift under the risk-neutral measure.
+*   \param 		payoff - The option to price.
+*   \param 		step - The scheme to step with, see scheme_step().
+*   \param 		p - Reference to our parameters (strike, vol, time, etc.)
+*   \param      N - The number of Monte Carlo simulations
+*   \param      ts - The number of time steps
+*   \param      rng - Gaussian variates, N per step, drawn from its cursor as in the schemes.
+*   \return		Pricing_result . The price, its standard error and the payoff statistics.
+*
+*/
+Pricing_result price_option(const Payoff &payoff, Step_function step, const Parameters &p, int N, int ts,
+                            const Gaussian_RNs &rng) {
+
+    Running_stats stats;
+    Step_table table{p, ts};
+    price_paths(payoff, step, p, table, N, ts,
+                [&](double *out, int n) { std::generate(out, out + n, std::ref(rng)); }, stats);
+    return result_from(stats);
+}
+
+/** \brief 		Prices an option on the scheduler's workers. The paths are split into blocks that
+*				draw their variates from per-worker Block_streams seeked to (seed, block), so the
+*				price does not depend on the number of workers and memory is O(workers * block).
+*   \param      seed - The seed of the Block_streams.
+*   \param      scheduler - The work-stealing scheduler to run on.
+*   \param      checkpoint - Where to save and resume progress, or nullptr, see parallel_blocks().
+*
+*/
+Pricing_result price_option(const Payoff &payoff, Step_function step, const Parameters &p, long N, int ts,
+                            std::uint64_t seed, Scheduler &scheduler, const Checkpoint *checkpoint) {
+
+    SDE_PHASE("payoff.total");
+
+    Step_table table{p, ts};
+    auto paths = [&](long, int n, auto draw, Running_stats &st) {
+        price_paths(payoff, step, p, table, n, ts, draw, st);
+    };
+    std::string run = checkpoint ? run_key("price_option", payoff, scheme_name(step), ts, p) : "";
+    Running_stats stats = parallel_blocks<Running_stats>(scheduler, N, seed, paths, checkpoint, run);
+    return result_from(stats);
+}
+
+/** \brief 		Prices an option on a basket of correlated assets, evaluated on the basket level
+*				sum_a weights[a] * S_a, on the scheduler's workers as price_option(). Memory is
+*				O(workers * block * assets) whatever the number of steps. Payoffs are discounted
+*				at the mu of the first asset: under the risk-neutral measure every asset drifts
+*				at the same rate.
+*   \param 		assets - The correlated assets.
+*   \param      weights - One weight per asset.
+*   \param      step - The single-asset scheme every asset is stepped with, see scheme_step().
+*   \param      checkpoint - Where to save and resume progress, or nullptr, see parallel_blocks().
+*
+*/
+Pricing_result price_basket(const Payoff &payoff, const Correlated_assets &assets, const std::valarray<double> &weights,
+                            Step_function step, long N, int ts, std::uint64_t seed, Scheduler &scheduler,
+                            const Checkpoint *checkpoint) {
+
+    SDE_PHASE("payoff.basket");
+
+    if (weights.size() != static_cast<std::size_t>(assets.num_assets())) {
+        std::cerr << "Error. Expected " << assets.num_assets() << " basket weights, got " << weights.size() << "."
+                  << '\n';
+        exit(1);
+    }
+
+    std::vector<Step_table> tables;
+    for (int a = 0; a < assets.num_assets(); ++a) {
+        tables.emplace_back(assets.asset(a), ts);
+    }
+
+    auto paths = [&](long, int n, auto draw, Running_stats &st) {
+        basket_paths(payoff, assets, tables, weights, step, n, ts, draw, st);
+    };
+
+    std::stringstream run;
+    if (checkpoint) {
+        run << "price_basket | " << payoff.key() << " | scheme=" << scheme_name(step) << " ts=" << ts << std::hexfloat
+            << " | weights";
+        for (double w : weights) {
+            run << ' ' << w;
+        }
+        run << " | cholesky";
+        for (double c : assets.cholesky_factor()) {
+            run << ' ' << c;
+        }
+        for (int a = 0; a < assets.num_assets(); ++a) {
+            run << " | " << parameters_key(assets.asset(a));
+        }
+    }
+    Running_stats stats = parallel_blocks<Running_stats>(scheduler, N, seed, paths, checkpoint, run.str());
+    return result_from(stats);
+}
+
+/** \brief 		Prices an option and estimates its delta, gamma and vega in the same pass over
+*				the time steps, on the scheduler's workers as price_option(). Delta and vega are
+*				pathwise for European and Asian payoffs under every scheme. Under the exact scheme
+*				gamma, and the delta and vega of barriers, use likelihood ratio scores. Greeks
+*				with no estimator for the scheme are NaN; bump_and_revalue() covers those.
+*   \param 		scheme - "exact", "milstein" or "euler_maruyama".
+*   \param      checkpoint - Where to save and resume progress, or nullptr, see parallel_blocks().
+*   \return		Greeks_result . The price and the three sensitivities with standard errors.
+*
+*/
+Greeks_result price_with_greeks(const Payoff &payoff, const std::string &scheme, const Parameters &p, long N, int ts,
+                                std::uint64_t seed, Scheduler &scheduler, const Checkpoint *checkpoint) {
+
+    SDE_PHASE("payoff.greeks");
+    check_scheme(scheme);
+
+    if (p.local_vol) {
+        std::cerr << "Error. The pathwise and likelihood ratio Greeks need a deterministic sigma(t), use "
+                  << "bump_and_revalue() with a local volatility surface." << '\n';
+        exit(1);
+    }
+
+    Step_function step = scheme_step(scheme);
+    Tangent_function tangent = scheme_sigma_tangent(scheme);
+    bool exact = scheme == "exact";
+    Step_table table{p, ts};
+
+    auto paths = [&](long, int n, auto draw, Greek_stats &st) {
+        greek_paths(payoff, step, tangent, exact, p, table, n, ts, draw, st);
+    };
+    std::string run = checkpoint ? run_key("price_with_greeks", payoff, scheme, ts, p) : "";
+    Greek_stats stats = parallel_blocks<Greek_stats>(scheduler, N, seed, paths, checkpoint, run);
+
+    std::string first_order = stats.pathwise ? "pathwise" : "likelihood ratio";
+    return Greeks_result{result_from(stats.price), sensitivity_from(stats.delta, first_order),
+                         sensitivity_from(stats.gamma, stats.pathwise ? "pathwise-LR" : "likelihood ratio"),
+                         sensitivity_from(stats.vega, first_order)};
+}
+
+/** \brief 		Finite-difference Greeks for validating price_with_greeks(): central differences
+*				in S0 and sigma with bumps of rel_bump * S0 and rel_bump * sigma. The base and the
+*				four bumped runs are stepped together on the same variates, so the differences are
+*				taken path by path and their standard errors are those of the differences.
+*   \param 		rel_bump - The bump size relative to the parameter.
+*   \param      checkpoint - Where to save and resume progress, or nullptr, see parallel_blocks().
+*
+*/
+Greeks_result bump_and_revalue(const Payoff &payoff, const std::string &scheme, const Parameters &p, long N, int ts,
+                               std::uint64_t seed, Scheduler &scheduler, double rel_bump,
+                               const Checkpoint *checkpoint) {
+
+    SDE_PHASE("payoff.bump_and_revalue");
+    check_scheme(scheme);
+
+    Step_function step = scheme_step(scheme);
+    double h_S0 = rel_bump * p.S0;
+    double h_sigma = rel_bump * p.sigma;
+
+    // Vega is the sensitivity to a parallel shift of sigma and of its term structure.
+    std::vector<Parameters> bumped(5, p);
+    bumped[1].S0 += h_S0;
+    bumped[2].S0 -= h_S0;
+    for (int j = 3; j < 5; ++j) {
+        double shift = j == 3 ? h_sigma : -h_sigma;
+        bumped[j].sigma += shift;
+        for (auto &s : bumped[j].term_sigma) {
+            s += shift;
+        }
+    }
+
+    std::vector<Step_table> tables;
+    for (const auto &b : bumped) {
+        tables.emplace_back(b, ts);
+    }
+
+    auto paths = [&](long, int n, auto draw, Greek_stats &st) {
+        bumped_paths(payoff, step, bumped, tables, h_S0, h_sigma, n, ts, draw, st);
+    };
+    std::stringstream engine;
+    engine << "bump_and_revalue rel_bump=" << std::hexfloat << rel_bump;
+    std::string run = checkpoint ? run_key(engine.str(), payoff, scheme, ts, p) : "";
+    Greek_stats stats = parallel_blocks<Greek_stats>(scheduler, N, seed, paths, checkpoint, run);
+
+    return Greeks_result{result_from(stats.price), sensitivity_from(stats.delta, "bump"),
+                         sensitivity_from(stats.gamma, "bump"), sensitivity_from(stats.vega, "bump")};
+}
+
+/** \brief      Black-Scholes price of a European option with rate mu, for checking the engine.
+*/
+double black_scholes(Option_type type, const Parameters &p, double strike) {
+    double tau = p.T - p.t0;
+    double sd = p.sigma * std::sqrt(tau);
+    double d1 = (std::log(p.S0 / strike) + (p.mu + 0.5 * p.sigma * p.sigma) * tau) / sd;
+    double d2 = d1 - sd;
+    double df = std::exp(-p.mu * tau);
+
+    if (type == Option_type::call) {
+        return p.S0 * norm_cdf(d1) - strike * df * norm_cdf(d2);
+    }
+    return strike * df * norm_cdf(-d2) - p.S0 * norm_cdf(-d1);
+}
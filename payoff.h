@@ -0,0 +1,184 @@
+#ifndef PAYOFF_H_QXDNRWEL
+#define PAYOFF_H_QXDNRWEL
+
+#include <valarray>
+#include <string>
+#include <cstdint>
+#include <cmath>
+
+#include "simulation.h"
+#include "multi_asset.h"
+#include "empirical.h"
+#include "scheduler.h"
+#include "checkpoint.h"
+
+enum class Option_type { call, put };
+
+enum class Barrier_type { up_and_out, up_and_in, down_and_out, down_and_in };
+
+/**
+ * \brief The path-dependent state of a block of paths: running sum of prices (for the average), running
+ *        minimum and running maximum. Updated after every time step, so a payoff never needs the grid.
+ *
+ * Only the accumulators a payoff asks for are allocated and updated. The minimum and maximum start at S0,
+ * so a barrier is also monitored at t0.
+ */
+class Path_accumulators {
+public:
+    enum : unsigned { none = 0, average = 1, minimum = 2, maximum = 4 };
+
+    Path_accumulators(unsigned which, int n, double S0);
+
+    void observe(const std::valarray<double> &prices);
+
+    std::valarray<double> average_price() const { return sum_ / static_cast<double>(num_obs_); }
+
+    const std::valarray<double> &running_min() const { return min_; }
+
+    const std::valarray<double> &running_max() const { return max_; }
+
+private:
+    unsigned which_;
+    int num_obs_ = 0;
+    std::valarray<double> sum_;
+    std::valarray<double> min_;
+    std::valarray<double> max_;
+};
+
+/**
+ * \brief Undiscounted payoff of a block of paths, computed from the terminal prices and the accumulators
+ *        it asked for.
+ *
+ * pathwise() gives the derivative of the payoff along each path with respect to a parameter, from the
+ * derivatives of the terminal price and of the average price with respect to it, for payoffs whose
+ * has_pathwise() is true. Payoffs that are not Lipschitz in the path (barriers) have none and their
+ * sensitivities use likelihood ratios instead. key() describes the payoff exactly, for checkpoints.
+ */
+class Payoff {
+public:
+    virtual ~Payoff() = default;
+
+    virtual unsigned accumulators() const { return Path_accumulators::none; }
+
+    virtual std::string key() const = 0;
+
+    virtual std::valarray<double> value(const std::valarray<double> &terminal,
+                                        const Path_accumulators &acc) const = 0;
+
+    virtual bool has_pathwise() const { return false; }
+
+    virtual void pathwise(const std::valarray<double> &, const Path_accumulators &, const std::valarray<double> &,
+                          const std::valarray<double> &, std::valarray<double> &) const {}
+};
+
+class European : public Payoff {
+public:
+    European(Option_type type, double strike) : type_(type), strike_(strike) {}
+
+    std::string key() const override;
+
+    std::valarray<double> value(const std::valarray<double> &terminal, const Path_accumulators &acc) const override;
+
+    bool has_pathwise() const override { return true; }
+
+    void pathwise(const std::valarray<double> &terminal, const Path_accumulators &acc,
+                  const std::valarray<double> &d_terminal, const std::valarray<double> &d_average,
+                  std::valarray<double> &out) const override;
+
+private:
+    Option_type type_;
+    double strike_;
+};
+
+/**
+ * \brief Arithmetic average price option. The average is over the prices at t0 + delta_t, ..., T.
+ */
+class Asian : public Payoff {
+public:
+    Asian(Option_type type, double strike) : type_(type), strike_(strike) {}
+
+    std::string key() const override;
+
+    unsigned accumulators() const override { return Path_accumulators::average; }
+
+    std::valarray<double> value(const std::valarray<double> &terminal, const Path_accumulators &acc) const override;
+
+    bool has_pathwise() const override { return true; }
+
+    void pathwise(const std::valarray<double> &terminal, const Path_accumulators &acc,
+                  const std::valarray<double> &d_terminal, const std::valarray<double> &d_average,
+                  std::valarray<double> &out) const override;
+
+private:
+    Option_type type_;
+    double strike_;
+};
+
+/**
+ * \brief Knock-in or knock-out option with the barrier monitored at every time step.
+ */
+class Barrier : public Payoff {
+public:
+    Barrier(Option_type type, double strike, Barrier_type barrier, double level)
+        : type_(type), strike_(strike), barrier_(barrier), level_(level) {}
+
+    unsigned accumulators() const override;
+
+    std::string key() const override;
+
+    std::valarray<double> value(const std::valarray<double> &terminal, const Path_accumulators &acc) const override;
+
+private:
+    Option_type type_;
+    double strike_;
+    Barrier_type barrier_;
+    double level_;
+};
+
+/**
+ * \brief Monte Carlo price of an option: the mean of the discounted payoffs with its standard error, and the
+ *        streaming statistics of the discounted payoffs.
+ */
+struct Pricing_result {
+    double price;
+    double std_error;
+    Running_stats stats;
+};
+
+/**
+ * \brief A Monte Carlo sensitivity with its standard error and the estimator it came from ("pathwise",
+ *        "likelihood ratio", "pathwise-LR" or "bump"). NaN when no estimator applies.
+ */
+struct Sensitivity {
+    double value = NAN;
+    double std_error = NAN;
+    std::string method = "none";
+};
+
+struct Greeks_result {
+    Pricing_result price;
+    Sensitivity delta;
+    Sensitivity gamma;
+    Sensitivity vega;
+};
+
+Pricing_result price_option(const Payoff &payoff, Step_function step, const Parameters &p, int N, int ts,
+                            const Gaussian_RNs &rng);
+
+Pricing_result price_option(const Payoff &payoff, Step_function step, const Parameters &p, long N, int ts,
+                            std::uint64_t seed, Scheduler &scheduler, const Checkpoint *checkpoint = nullptr);
+
+Pricing_result price_basket(const Payoff &payoff, const Correlated_assets &assets, const std::valarray<double> &weights,
+                            Step_function step, long N, int ts, std::uint64_t seed, Scheduler &scheduler,
+                            const Checkpoint *checkpoint = nullptr);
+
+Greeks_result price_with_greeks(const Payoff &payoff, const std::string &scheme, const Parameters &p, long N, int ts,
+                                std::uint64_t seed, Scheduler &scheduler, const Checkpoint *checkpoint = nullptr);
+
+Greeks_result bump_and_revalue(const Payoff &payoff, const std::string &scheme, const Parameters &p, long N, int ts,
+                               std::uint64_t seed, Scheduler &scheduler, double rel_bump = 0.01,
+                               const Checkpoint *checkpoint = nullptr);
+
+double black_scholes(Option_type type, const Parameters &p, double strike);
+
+#endif /* end of include guard: PAYOFF_H_QXDNRWEL */
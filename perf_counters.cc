@@ -0,0 +1,127 @@
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <atomic>
+#include <iostream>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perf_counters.h"
+
+namespace perf_counters {
+
+namespace {
+
+#ifdef __linux__
+
+/**
+ * \brief The counter group of one thread. The cycles counter leads the group and the file
+ *        descriptors are closed when the thread exits.
+ */
+class Thread_group {
+public:
+    Thread_group() {
+        const std::uint64_t configs[num_events][2] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+
+        for (int e = 0; e < num_events; ++e) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = static_cast<std::uint32_t>(configs[e][0]);
+            attr.config = configs[e][1];
+            attr.disabled = (e == 0);           //< The leader starts the whole group
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            fd_[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, e == 0 ? -1 : fd_[0], 0));
+            if (fd_[e] < 0) {
+                static std::atomic<bool> warned{false};
+                if (warned.exchange(true)) {
+                    close_all();
+                    return;
+                }
+                std::cerr << "perf_event_open failed for " << event_name(e) << ": " << std::strerror(errno)
+                          << ". Hardware counters are unavailable." << '\n';
+                close_all();
+                return;
+            }
+        }
+
+        ioctl(fd_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fd_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        open_ = true;
+    }
+
+    ~Thread_group() {
+        close_all();
+    }
+
+    Sample read() const {
+        Sample s;
+        if (!open_) {
+            return s;
+        }
+
+        std::uint64_t buf[1 + num_events];      //< nr, then one value per event
+        if (::read(fd_[0], buf, sizeof(buf)) == static_cast<ssize_t>(sizeof(buf)) && buf[0] == num_events) {
+            for (int e = 0; e < num_events; ++e) {
+                s.value[e] = static_cast<std::int64_t>(buf[1 + e]);
+            }
+            s.valid = true;
+        }
+        return s;
+    }
+
+private:
+    void close_all() {
+        for (int &fd : fd_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+        }
+        open_ = false;
+    }
+
+    int fd_[num_events] = {-1, -1, -1, -1};
+    bool open_ = false;
+};
+
+#else
+
+struct Thread_group {
+    Sample read() const { return Sample{}; }
+};
+
+#endif
+
+} // namespace
+
+/** \brief      Reads the counters of the calling thread, opening them on first use.
+*   \return     Sample . The running totals, valid is false if the counters could not be opened.
+*/
+Sample read() {
+    thread_local Thread_group group;
+    return group.read();
+}
+
+/** \brief      Name of a counter as used in the phase report.
+*/
+const char *event_name(int event) {
+    static const char *names[num_events] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+    return names[event];
+}
+
+} // namespace perf_counters
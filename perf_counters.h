@@ -0,0 +1,33 @@
+#ifndef PERF_COUNTERS_H_RBNXCUAE
+#define PERF_COUNTERS_H_RBNXCUAE
+
+#include <cstdint>
+
+/**
+ * \brief Hardware performance counters of the calling thread, read through Linux perf_event_open.
+ *
+ * Compiled in by make PERF=1 (SDE_PERF_COUNTERS), which also turns on the phase timers of instrument.h so
+ * that every SDE_PHASE records the counter deltas over its scope. The counters are opened lazily, once
+ * per thread, as one group so that they are scheduled together. When the kernel refuses them (e.g.
+ * perf_event_paranoid, containers, non-Linux) read() returns samples marked invalid and the phase report
+ * shows the counters as unavailable.
+ */
+namespace perf_counters {
+
+enum Event { cycles, instructions, llc_misses, branch_misses, num_events };
+
+/**
+ * \brief Counter values for the calling thread at one point in time.
+ */
+struct Sample {
+    std::int64_t value[num_events] = {};
+    bool valid = false;
+};
+
+Sample read();
+
+const char *event_name(int event);
+
+} // namespace perf_counters
+
+#endif /* end of include guard: PERF_COUNTERS_H_RBNXCUAE */
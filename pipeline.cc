@@ -0,0 +1,249 @@
+#include <vector>
+#include <valarray>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "pipeline.h"
+#include "instrument.h"
+#include "scheduler.h"
+
+namespace {
+
+/**
+ * \brief The work of one chunk as it moves down the pipeline: the variates of its blocks, then their prices.
+ */
+struct Chunk {
+    long first_block;
+    std::vector<long> first_path;               //!< Of each block, and the end of the last one
+    std::vector<double> variates;               //!< Block by block, ts x n of each, step-major
+    std::valarray<double> prices;               //!< The terminal price of every path of the chunk
+};
+
+/**
+ * \brief The four stages, each a function of one chunk. Every stage is called by one thread only; the
+ *        step stage hands the blocks of its chunk to the scheduler.
+ */
+class Stages {
+public:
+    explicit Stages(const Pipeline_spec &spec)
+            : spec_{spec}, step_{scheme_step(spec.scheme)}, table_{spec.params, spec.num_timesteps},
+              delta_t_{(spec.params.T - spec.params.t0) / spec.num_timesteps},
+              hist_{100, spec.bin_width}, outfile_{spec.outfile} {
+
+        if (!outfile_.is_open()) {
+            std::cerr << "Error opening outfile." << '\n';
+            exit(1);
+        }
+        outfile_ << std::setprecision(10);
+    }
+
+    long num_blocks() const {
+        return (spec_.num_sims + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+    }
+
+    /** \brief      Draws the variates of the blocks of chunk k from their own streams.
+    */
+    Chunk generate(long k) {
+        Timer t{seconds[0]};
+        SDE_PHASE("pipeline.generate");
+
+        Chunk c;
+        c.first_block = k * spec_.blocks_per_chunk;
+        long last_block = std::min(num_blocks(), c.first_block + spec_.blocks_per_chunk);
+        for (long b = c.first_block; b <= last_block; ++b) {
+            c.first_path.push_back(std::min(spec_.num_sims, b * Block_stream::paths_per_block));
+        }
+        c.variates.resize(static_cast<std::size_t>(c.first_path.back() - c.first_path.front()) * spec_.num_timesteps);
+
+        double *out = c.variates.data();
+        for (long b = c.first_block; b < last_block; ++b) {
+            int n = static_cast<int>(c.first_path[b - c.first_block + 1] - c.first_path[b - c.first_block]);
+            stream_.seek(spec_.seed, b);
+            for (int s = 0; s < spec_.num_timesteps; ++s, out += n) {
+                stream_.fill(out, n);
+            }
+        }
+        return c;
+    }
+
+    /** \brief      Steps the paths of every block of a chunk from t0 to T, one block per scheduler task.
+    */
+    void step(Chunk &c, Scheduler &scheduler) {
+        Timer t{seconds[1]};
+        SDE_PHASE("pipeline.step");
+
+        c.prices.resize(c.first_path.back() - c.first_path.front());
+        scheduler.parallel_for(static_cast<int>(c.first_path.size()) - 1, [&](int i) {
+            std::size_t offset = c.first_path[i] - c.first_path.front();
+            int n = static_cast<int>(c.first_path[i + 1] - c.first_path[i]);
+            const double *z = c.variates.data() + offset * spec_.num_timesteps;
+            std::valarray<double> prices(spec_.params.S0, n);
+            std::valarray<double> rans(n);
+            for (int k = 0; k < spec_.num_timesteps; ++k, z += n) {
+                std::copy(z, z + n, std::begin(rans));
+                step_(prices, rans, table_[k], delta_t_);
+            }
+            c.prices[std::slice(offset, n, 1)] = prices;
+        });
+        c.variates = std::vector<double>();
+    }
+
+    /** \brief      Merges the moments of each block of a chunk, in block order, and bins its prices.
+    */
+    void reduce(const Chunk &c) {
+        Timer t{seconds[2]};
+        SDE_PHASE("pipeline.reduce");
+
+        for (std::size_t i = 0; i + 1 < c.first_path.size(); ++i) {
+            Running_stats block;
+            std::size_t n = c.first_path[i + 1] - c.first_path[i];
+            block.add(c.prices[std::slice(c.first_path[i] - c.first_path.front(), n, 1)]);
+            stats_.merge(block);
+        }
+        hist_.add(c.prices);
+    }
+
+    /** \brief      Appends the terminal prices of a chunk to the outfile.
+    */
+    void write(const Chunk &c) {
+        Timer t{seconds[3]};
+        SDE_PHASE("pipeline.write");
+
+        for (double x : c.prices) {
+            outfile_ << x << '\n';
+        }
+    }
+
+    const Running_stats &stats() const { return stats_; }
+
+    const Running_histogram &hist() const { return hist_; }
+
+    double seconds[4] = {0, 0, 0, 0};
+
+private:
+    /**
+     * \brief Adds the lifetime of its scope to a stage's busy time.
+     */
+    struct Timer {
+        double &total;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        ~Timer() {
+            total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    const Pipeline_spec &spec_;
+    Step_function step_;
+    Step_table table_;
+    double delta_t_;
+    Block_stream stream_;
+    Running_stats stats_;
+    Running_histogram hist_;
+    std::ofstream outfile_;
+};
+
+} // namespace
+
+/** \brief 		Runs the four stages over every chunk. Overlapped, each stage runs on its own thread
+*				and hands its chunks to the next through a Bounded_queue of queue_depth, so chunk
+*				k is written while k+1 is reduced, k+2 stepped and k+3 generated. At most
+*				3 x queue_depth + 4 chunks are alive at once, only the generated ones holding
+*				variates, and the run takes about as long as its slowest stage instead of the sum
+*				of all four. Otherwise every chunk passes through the stages in turn on the calling
+*				thread, as a reference. Either way the step stage, the only one whose work grows
+*				with the number of time steps, spreads the blocks of its chunk over the scheduler.
+*   \param 		spec - The run and the pipeline's chunk size and queue depth.
+*   \param      scheduler - Steps the blocks of each chunk.
+*   \param      overlapped - Whether to run the stages concurrently.
+*   \return		Pipeline_result . The statistics, the busy time of each stage and the wall time.
+*
+*/
+Pipeline_result run_pipeline(const Pipeline_spec &spec, Scheduler &scheduler, bool overlapped) {
+
+    if (spec.blocks_per_chunk < 1 || spec.queue_depth < 1) {
+        std::cerr << "Error. The pipeline needs at least one block per chunk and one chunk per queue." << '\n';
+        exit(1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Stages stages{spec};
+    long num_chunks = (stages.num_blocks() + spec.blocks_per_chunk - 1) / spec.blocks_per_chunk;
+
+    if (overlapped) {
+        Bounded_queue<Chunk> generated(spec.queue_depth);
+        Bounded_queue<Chunk> stepped(spec.queue_depth);
+        Bounded_queue<Chunk> reduced(spec.queue_depth);
+
+        std::thread generator([&] {
+            for (long k = 0; k < num_chunks; ++k) {
+                generated.push(stages.generate(k));
+            }
+            generated.close();
+        });
+        std::thread stepper([&] {
+            Chunk c;
+            while (generated.pop(c)) {
+                stages.step(c, scheduler);
+                stepped.push(std::move(c));
+            }
+            stepped.close();
+        });
+        std::thread reducer([&] {
+            Chunk c;
+            while (stepped.pop(c)) {
+                stages.reduce(c);
+                reduced.push(std::move(c));
+            }
+            reduced.close();
+        });
+
+        Chunk c;
+        while (reduced.pop(c)) {
+            stages.write(c);
+        }
+        generator.join();
+        stepper.join();
+        reducer.join();
+    } else {
+        for (long k = 0; k < num_chunks; ++k) {
+            Chunk c = stages.generate(k);
+            stages.step(c, scheduler);
+            stages.reduce(c);
+            stages.write(c);
+        }
+    }
+
+    Pipeline_result result{stages.stats(), stages.hist(), {}, 0};
+    std::copy(std::begin(stages.seconds), std::end(stages.seconds), std::begin(result.stage_seconds));
+    result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+/** \brief      Prints the moments of the terminal prices, the busy time of each stage and the
+*               wall time next to the sum and the maximum of the stage times.
+*/
+void print_pipeline_result(const Pipeline_result &result, std::ostream &out) {
+
+    const char *names[] = {"generate", "step", "reduce", "write"};
+    double sum = 0;
+    double slowest = 0;
+
+    out << std::setprecision(6) << "  mean     " << result.stats.mean() << '\n'
+        << "  variance " << result.stats.variance() << '\n';
+    for (int s = 0; s < 4; ++s) {
+        out << "  " << std::setw(9) << std::left << names[s] << std::right << result.stage_seconds[s] << " s" << '\n';
+        sum += result.stage_seconds[s];
+        slowest = std::max(slowest, result.stage_seconds[s]);
+    }
+    out << "  wall     " << result.wall_seconds << " s (stages: sum " << sum << " s, slowest " << slowest << " s)"
+        << '\n';
+}
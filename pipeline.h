@@ -0,0 +1,98 @@
+#ifndef PIPELINE_H_KDWQRBXA
+#define PIPELINE_H_KDWQRBXA
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <iostream>
+#include <condition_variable>
+
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+
+/**
+ * \brief A first-in first-out queue holding at most capacity items, between two pipeline stages.
+ *
+ * push() blocks while the queue is full and pop() while it is empty, so a fast stage waits for a slow one
+ * instead of piling up chunks in memory. close() marks the end of the input: pop() then returns false once
+ * the queue has drained.
+ */
+template <typename T>
+class Bounded_queue {
+public:
+    explicit Bounded_queue(std::size_t capacity) : capacity_{capacity} {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [&] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T &item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [&] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+
+private:
+    std::size_t capacity_;
+    std::deque<T> items_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_full_;
+    std::condition_variable not_empty_;
+};
+
+/**
+ * \brief A terminal-price run split into chunks of Block_stream blocks, each passing through four stages:
+ *        generate its variates, step its paths to T, reduce its prices into the statistics and write them out.
+ *
+ * Blocks draw from their own seeked streams and are reduced in block order, so the statistics equal those of
+ * parallel_blocks() over the same N and seed, whether or not the stages overlap.
+ *
+ * Generate, reduce and write each keep one thread: the first advances one stream through the blocks in
+ * order, the last two fold chunks into a single accumulator and file in chunk order, so more threads would
+ * only contend. Stepping is the bulk of the work and its blocks are independent, so it runs on a Scheduler.
+ */
+struct Pipeline_spec {
+    std::string scheme = "exact";
+    Parameters params;
+    long num_sims;
+    int num_timesteps;
+    std::uint64_t seed;
+    std::string outfile;                //!< The terminal prices are written here, one per line
+    double bin_width;                   //!< Of the histogram of the terminal prices
+    int blocks_per_chunk = 4;
+    int queue_depth = 2;                //!< Chunks waiting between two stages at most
+};
+
+/**
+ * \brief The reduced statistics of a pipelined run, the busy time of each stage and the wall time.
+ */
+struct Pipeline_result {
+    Running_stats stats;
+    Running_histogram hist;
+    double stage_seconds[4];            //!< generate, step, reduce, write
+    double wall_seconds;
+};
+
+Pipeline_result run_pipeline(const Pipeline_spec &spec, Scheduler &scheduler, bool overlapped = true);
+
+void print_pipeline_result(const Pipeline_result &result, std::ostream &out);
+
+#endif /* end of include guard: PIPELINE_H_KDWQRBXA */
@@ -0,0 +1,228 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <cstdlib>
+#include <cstdint>
+#include <new>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "myrandom.h"
+#include "placement.h"
+#include "scheduler.h"
+#include "instrument.h"
+
+namespace {
+
+const std::size_t huge_page_size = 2 << 20;         //!< The x86-64 and arm64 default
+
+/** \brief      Parses a sysfs cpu list such as "0-3,8-11".
+*/
+std::vector<int> parse_cpu_list(const std::string &list) {
+
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        std::size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int c = first; c <= last; ++c) {
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+Placement read_placement() {
+
+    Placement p;
+    if (const char *pin = std::getenv("SDE_PIN")) {
+        std::string s{pin};
+        p.pin = s == "cores" ? Pin_policy::cores : s == "nodes" ? Pin_policy::nodes : Pin_policy::none;
+    }
+    if (const char *huge = std::getenv("SDE_HUGE_PAGES")) {
+        std::string s{huge};
+        p.huge_pages = s == "transparent" ? Huge_pages::transparent
+                                          : s == "explicit" ? Huge_pages::explicit_pages : Huge_pages::none;
+    }
+    return p;
+}
+
+std::vector<std::vector<int>> read_numa_nodes() {
+
+    std::vector<std::vector<int>> nodes;
+    for (int n = 0;; ++n) {
+        std::ifstream infile("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist");
+        std::string list;
+        if (!infile.is_open() || !std::getline(infile, list)) {
+            break;
+        }
+        if (!list.empty()) {
+            nodes.push_back(parse_cpu_list(list));
+        }
+    }
+
+    if (nodes.empty()) {                                //< no sysfs: one node of every cpu
+        nodes.emplace_back();
+        for (unsigned c = 0; c < std::max(1u, std::thread::hardware_concurrency()); ++c) {
+            nodes.back().push_back(static_cast<int>(c));
+        }
+    }
+    return nodes;
+}
+
+} // namespace
+
+/** \brief      The placement policy of the process, from SDE_PIN and SDE_HUGE_PAGES.
+*/
+const Placement &placement() {
+    static const Placement p = read_placement();
+    return p;
+}
+
+/** \brief      The cpus of each NUMA node, from sysfs. One node holding every cpu when the
+*               machine has no NUMA information.
+*/
+const std::vector<std::vector<int>> &numa_nodes() {
+    static const std::vector<std::vector<int>> nodes = read_numa_nodes();
+    return nodes;
+}
+
+/** \brief 		Pins the calling thread, worker index of its pool, by policy. cores pins worker i
+*				to the i-th cpu counting node by node, so consecutive workers share a node;
+*				nodes lets worker i run on any cpu of node i mod the number of nodes.
+*   \return		bool . Whether the affinity was set (always true for Pin_policy::none).
+*
+*/
+bool pin_current_thread(Pin_policy policy, int index) {
+
+    if (policy == Pin_policy::none) {
+        return true;
+    }
+
+    const auto &nodes = numa_nodes();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    if (policy == Pin_policy::cores) {
+        std::vector<int> cpus;
+        for (const auto &node : nodes) {
+            cpus.insert(cpus.end(), node.begin(), node.end());
+        }
+        CPU_SET(cpus[index % cpus.size()], &set);
+    } else {
+        for (int c : nodes[index % nodes.size()]) {
+            CPU_SET(c, &set);
+        }
+    }
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+/** \brief 		Allocates bytes of uninitialised memory. A huge page or more is mapped directly,
+*				in whole huge pages starting on a huge page boundary, and backed as pages says.
+*				mmap only aligns to the base page, so one huge page more is mapped and the slack
+*				before the boundary and after the buffer is unmapped. Nothing is written, so no
+*				page is placed until it is first touched.
+*   \param 		bytes - The size of the buffer.
+*   \param      pages - How to back it.
+*   \return		void* . The buffer, to be released by free_pages() with the same size.
+*
+*/
+void *allocate_pages(std::size_t bytes, Huge_pages pages) {
+
+    if (bytes < huge_page_size) {
+        return ::operator new(bytes);
+    }
+
+    std::size_t length = (bytes + huge_page_size - 1) / huge_page_size * huge_page_size;
+    void *p = MAP_FAILED;
+
+    if (pages == Huge_pages::explicit_pages) {
+        p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (p == MAP_FAILED) {
+        void *mapped = mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                            -1, 0);
+        if (mapped == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(mapped);
+        std::size_t head = (huge_page_size - start % huge_page_size) % huge_page_size;
+        if (head > 0) {
+            munmap(mapped, head);
+        }
+        munmap(reinterpret_cast<char *>(mapped) + head + length, huge_page_size - head);
+        p = reinterpret_cast<char *>(mapped) + head;
+        if (pages != Huge_pages::none) {
+            madvise(p, length, MADV_HUGEPAGE);          //< a hint, ignored when THP is disabled
+        }
+    }
+
+    SDE_COUNT("bytes_mapped", length);
+    return p;
+}
+
+/** \brief      Releases a buffer from allocate_pages().
+*/
+void free_pages(void *p, std::size_t bytes) {
+
+    if (bytes < huge_page_size) {
+        ::operator delete(p);
+        return;
+    }
+    munmap(p, (bytes + huge_page_size - 1) / huge_page_size * huge_page_size);
+}
+
+/** \brief 		Zeroes a buffer of num_rows rows of num_paths doubles on the scheduler's workers,
+*				one Block_stream block of paths at a time, as parallel_blocks() hands them out: the
+*				task of a block zeroes its paths in every row. Each page of a fresh buffer is then
+*				placed on the node of the worker that is likely to simulate its paths, rather than
+*				all on the node of the allocating thread. Work stealing makes the match likely but
+*				not certain; pinning the workers keeps it from drifting.
+*   \param 		data - The buffer, row after row, e.g. a pool of variates num_paths per step.
+*   \param      num_paths - The length of a row.
+*   \param      scheduler - The workers that will use the buffer.
+*   \param      num_rows - The number of rows.
+*
+*/
+void first_touch(double *data, std::size_t num_paths, Scheduler &scheduler, int num_rows) {
+
+    SDE_PHASE("placement.first_touch", num_paths * num_rows);
+
+    const long chunk = Block_stream::paths_per_block;
+    long num_chunks = static_cast<long>((num_paths + chunk - 1) / chunk);
+    scheduler.parallel_range(0, num_chunks, 1, [&](long first, long count) {
+        std::size_t begin = first * chunk;
+        std::size_t end = std::min(num_paths, static_cast<std::size_t>(first + count) * chunk);
+        for (int r = 0; r < num_rows; ++r) {
+            double *row = data + static_cast<std::size_t>(r) * num_paths;
+            std::fill(row + begin, row + end, 0.0);
+        }
+    });
+}
+
+/** \brief 		As first_touch(), for a buffer that has already been written, e.g. a std::valarray
+*				zeroed by the thread that constructed it. Its whole pages are handed back to the
+*				kernel (MADV_DONTNEED), so that each is placed afresh by the worker that touches it
+*				next. The contents of the buffer are lost: it reads as zeros afterwards.
+*
+*/
+void first_touch_again(double *data, std::size_t num_paths, Scheduler &scheduler, int num_rows) {
+
+    const std::uintptr_t page = sysconf(_SC_PAGESIZE);
+    std::uintptr_t begin = (reinterpret_cast<std::uintptr_t>(data) + page - 1) / page * page;
+    std::uintptr_t end = reinterpret_cast<std::uintptr_t>(data + num_paths * num_rows) / page * page;
+    if (end > begin) {
+        madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+    }
+    first_touch(data, num_paths, scheduler, num_rows);
+}
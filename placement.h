@@ -0,0 +1,95 @@
+#ifndef PLACEMENT_H_WJZQHNEU
+#define PLACEMENT_H_WJZQHNEU
+
+#include <vector>
+#include <string>
+#include <cstddef>
+#include <utility>
+#include <new>
+
+class Scheduler;
+
+/**
+ * \brief Where worker threads run: anywhere, each on its own core (filling one NUMA node before the next),
+ *        or spread round robin over the NUMA nodes and free to move within their node.
+ */
+enum class Pin_policy { none, cores, nodes };
+
+/**
+ * \brief How large buffers are backed: by ordinary pages, by transparent huge pages (madvise) or by explicit
+ *        huge pages (MAP_HUGETLB, falling back to transparent ones when none are reserved).
+ */
+enum class Huge_pages { none, transparent, explicit_pages };
+
+/**
+ * \brief The process-wide placement policy, read once from the environment:
+ *
+ *  SDE_PIN=none|cores|nodes                        (default none)
+ *  SDE_HUGE_PAGES=none|transparent|explicit        (default none)
+ *
+ * Schedulers pin their workers by pin unless told otherwise, and Path_allocator backs its buffers by
+ * huge_pages. Huge pages are opt-in: where the kernel defragments synchronously for madvise'd regions
+ * (transparent_hugepage/defrag = madvise), faulting in a large buffer can stall on compaction for far
+ * longer than the TLB misses it saves.
+ */
+struct Placement {
+    Pin_policy pin = Pin_policy::none;
+    Huge_pages huge_pages = Huge_pages::none;
+};
+
+const Placement &placement();
+
+const std::vector<std::vector<int>> &numa_nodes();
+
+bool pin_current_thread(Pin_policy policy, int index);
+
+void *allocate_pages(std::size_t bytes, Huge_pages pages);
+
+void free_pages(void *p, std::size_t bytes);
+
+void first_touch(double *data, std::size_t num_paths, Scheduler &scheduler, int num_rows = 1);
+
+void first_touch_again(double *data, std::size_t num_paths, Scheduler &scheduler, int num_rows = 1);
+
+/**
+ * \brief Allocator for large path and variate buffers.
+ *
+ * Buffers of a huge page or more are mapped directly and backed as placement().huge_pages says, smaller
+ * ones come from operator new. Elements are default-initialised, so a std::vector<double> with this
+ * allocator does not write its memory on resize: each page is then placed on the NUMA node of the first
+ * thread to write it, which first_touch() can make the worker that will use it. Buffers that were written
+ * on allocation anyway (std::valarray) can be placed by first_touch_again().
+ */
+template <typename T>
+class Path_allocator {
+public:
+    using value_type = T;
+
+    Path_allocator() = default;
+
+    template <typename U>
+    Path_allocator(const Path_allocator<U> &) {}
+
+    T *allocate(std::size_t n) {
+        return static_cast<T *>(allocate_pages(n * sizeof(T), placement().huge_pages));
+    }
+
+    void deallocate(T *p, std::size_t n) { free_pages(p, n * sizeof(T)); }
+
+    template <typename U>
+    void construct(U *p) { ::new (static_cast<void *>(p)) U; }
+
+    template <typename U, typename... Args>
+    void construct(U *p, Args &&... args) { ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...); }
+
+    template <typename U>
+    bool operator==(const Path_allocator<U> &) const { return true; }
+
+    template <typename U>
+    bool operator!=(const Path_allocator<U> &) const { return false; }
+};
+
+template <typename T>
+using Path_vector = std::vector<T, Path_allocator<T>>;
+
+#endif /* end of include guard: PLACEMENT_H_WJZQHNEU */
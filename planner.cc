@@ -0,0 +1,151 @@
+#include <vector>
+#include <valarray>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+#include "simulation.h"
+#include "empirical.h"
+#include "planner.h"
+#include "scheduler.h"
+#include "instrument.h"
+
+/** \brief      One line summary of a plan: the strategy and the normals drawn per path.
+*/
+std::string Exact_plan::describe() const {
+
+    const char *names[] = {"single jump", "sparse dates", "full stepping"};
+    std::stringstream ss;
+    ss << names[strategy] << ": " << jump_steps.size() << " normal(s) per path instead of " << num_timesteps
+       << ", storing " << stored_steps.size() << " slice(s)";
+    return ss.str();
+}
+
+/** \brief 		Chooses how to run the exact scheme for the outputs a run needs. Terminal output
+*				is sampled in one jump from t0 to T, a monitoring schedule in one jump per date,
+*				and the full path by stepping. With a local volatility surface every step is
+*				taken, but only the needed slices are stored.
+*   \param 		p - Reference to our parameters.
+*   \param      ts - The number of time steps of the grid the outputs refer to.
+*   \param      need - Which outputs are needed.
+*   \param      observation_steps - The monitoring steps, in 1..ts, when need is schedule.
+*   \return		Exact_plan . The strategy with the steps to jump to and to store.
+*
+*/
+Exact_plan plan_exact(const Parameters &p, int ts, Output_need need, std::vector<int> observation_steps) {
+
+    std::vector<int> stored;
+
+    if (need == Output_need::terminal) {
+        stored = {ts};
+    } else if (need == Output_need::schedule) {
+        std::sort(observation_steps.begin(), observation_steps.end());
+        observation_steps.erase(std::unique(observation_steps.begin(), observation_steps.end()),
+                                observation_steps.end());
+        if (observation_steps.empty() || observation_steps.front() < 1 || observation_steps.back() > ts) {
+            std::cerr << "Error. Monitoring steps must lie in 1.." << ts << "." << '\n';
+            exit(1);
+        }
+        stored = observation_steps;
+    } else {
+        for (int k = 1; k <= ts; ++k) {
+            stored.push_back(k);
+        }
+    }
+
+    if (p.local_vol || need == Output_need::full_path) {
+        std::vector<int> every;
+        for (int k = 1; k <= stored.back(); ++k) {
+            every.push_back(k);
+        }
+        return Exact_plan{Exact_plan::full_stepping, ts, every, stored};
+    }
+
+    Exact_plan::Strategy strategy = stored.size() == 1 ? Exact_plan::single_jump : Exact_plan::sparse_dates;
+    return Exact_plan{strategy, ts, stored, stored};
+}
+
+/** \brief 		Runs a plan on the scheduler's workers, in Block_stream blocks as price_option().
+*				Each jump is one exact step over the interval between consecutive jump steps, with
+*				the average mu and root mean square sigma of that interval, so every strategy
+*				samples the same law at the stored steps. Full stepping uses the per-step table, and
+*				so the local volatility surface when there is one.
+*   \param 		p - Reference to our parameters.
+*   \param      N - The number of Monte Carlo simulations
+*   \param      plan - The plan from plan_exact().
+*   \param      seed - The seed of the Block_streams.
+*   \param      scheduler - The work-stealing scheduler to run on.
+*   \return		Planned_run . The stored slices, and the empirical and analytic moments of the last.
+*
+*/
+Planned_run run_exact_plan(const Parameters &p, long N, const Exact_plan &plan, std::uint64_t seed,
+                           Scheduler &scheduler) {
+
+    SDE_PHASE("planner.run", N * static_cast<long>(plan.jump_steps.size()));
+
+    double delta_t = (p.T - p.t0) / plan.num_timesteps;
+    std::vector<Parameters> jumps;
+    std::vector<double> jump_lengths;
+    Step_table table{p, plan.strategy == Exact_plan::full_stepping ? plan.num_timesteps : 1};
+
+    int prev = 0;
+    for (int k : plan.jump_steps) {
+        jumps.push_back(plan.strategy == Exact_plan::full_stepping ? table[k - 1]
+                                                                   : interval_parameters(p, p.t0 + prev * delta_t,
+                                                                                         p.t0 + k * delta_t));
+        jump_lengths.push_back((k - prev) * delta_t);
+        prev = k;
+    }
+
+    Planned_run run{plan, std::vector<std::valarray<double>>(plan.stored_steps.size(), std::valarray<double>(N)),
+                    Running_stats{}, 0, 0};
+
+    auto paths = [&](long first, int n, auto draw, Running_stats &st) {
+        std::valarray<double> prices(p.S0, n);
+        std::valarray<double> rans(n);
+        std::size_t next_stored = 0;
+
+        for (std::size_t j = 0; j < jumps.size(); ++j) {
+            draw(&rans[0], n);
+            Exact_path::step(prices, rans, jumps[j], jump_lengths[j]);
+            if (next_stored < plan.stored_steps.size() && plan.stored_steps[next_stored] == plan.jump_steps[j]) {
+                run.slices[next_stored++][std::slice(first, n, 1)] = prices;
+            }
+        }
+        st.add(prices);
+    };
+    run.last_stats = parallel_blocks<Running_stats>(scheduler, N, seed, paths);
+
+    // S_t is lognormal with log-mean log(S0) + int mu - int sigma^2 / 2 and log-variance int sigma^2.
+    double t = p.t0 + plan.jump_steps.back() * delta_t;
+    Parameters whole = interval_parameters(p, p.t0, t);
+    double growth = std::exp(whole.mu * (t - p.t0));
+    run.analytic_mean = p.S0 * growth;
+    run.analytic_variance = p.S0 * p.S0 * growth * growth * (std::exp(whole.sigma * whole.sigma * (t - p.t0)) - 1);
+    if (p.local_vol) {
+        run.analytic_mean = NAN;
+        run.analytic_variance = NAN;
+    }
+
+    return run;
+}
+
+/** \brief      Prints the plan and the empirical moments of the last stored step next to the
+*               analytic ones (not available under a local volatility surface).
+*/
+void print_planned_run(const Planned_run &run, std::ostream &out) {
+
+    out << "Plan: " << run.plan.describe() << '\n'
+        << std::setprecision(6) << "  mean     " << run.last_stats.mean();
+    if (std::isfinite(run.analytic_mean)) {
+        out << " (analytic " << run.analytic_mean << ")";
+    }
+    out << '\n' << "  variance " << run.last_stats.variance();
+    if (std::isfinite(run.analytic_variance)) {
+        out << " (analytic " << run.analytic_variance << ")";
+    }
+    out << '\n';
+}
@@ -0,0 +1,57 @@
+#ifndef PLANNER_H_GXRMOVZD
+#define PLANNER_H_GXRMOVZD
+
+#include <vector>
+#include <valarray>
+#include <string>
+#include <cstdint>
+#include <iostream>
+
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+
+/**
+ * \brief What a run of the exact scheme has to produce: the prices at T only, the prices at a set of
+ *        monitoring steps, or the prices at every step.
+ */
+enum class Output_need { terminal, schedule, full_path };
+
+/**
+ * \brief How the exact scheme will be run, chosen by plan_exact().
+ *
+ * The GBM transition over any interval is lognormal, so the exact scheme may jump straight from one stored
+ * step to the next: single_jump draws one normal per path, sparse_dates one per monitoring date. A local
+ * volatility surface has no such transition and forces full_stepping, which also stores only what is needed.
+ */
+struct Exact_plan {
+    enum Strategy { single_jump, sparse_dates, full_stepping };
+
+    Strategy strategy;
+    int num_timesteps;                  //!< The resolution the steps below refer to
+    std::vector<int> jump_steps;        //!< The steps the paths are advanced to, increasing
+    std::vector<int> stored_steps;      //!< The steps whose prices are kept, a subset of jump_steps
+
+    std::string describe() const;
+};
+
+/**
+ * \brief The output of an Exact_plan: the stored slices, the statistics of the last one and its analytic
+ *        mean and variance (NaN under a local volatility surface).
+ */
+struct Planned_run {
+    Exact_plan plan;
+    std::vector<std::valarray<double>> slices;      //!< One per plan.stored_steps
+    Running_stats last_stats;
+    double analytic_mean;
+    double analytic_variance;
+};
+
+Exact_plan plan_exact(const Parameters &p, int ts, Output_need need, std::vector<int> observation_steps = {});
+
+Planned_run run_exact_plan(const Parameters &p, long N, const Exact_plan &plan, std::uint64_t seed,
+                           Scheduler &scheduler);
+
+void print_planned_run(const Planned_run &run, std::ostream &out);
+
+#endif /* end of include guard: PLANNER_H_GXRMOVZD */
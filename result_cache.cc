@@ -0,0 +1,331 @@
+#include <map>
+#include <list>
+#include <vector>
+#include <valarray>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "result_cache.h"
+#include "instrument.h"
+
+namespace {
+
+const char magic[8] = {'S', 'D', 'E', 'R', 'E', 'S', '0', '1'};
+
+/** \brief      Appends the bytes of a trivially copyable value.
+*/
+template <typename T>
+void append(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void append(std::string &out, const std::string &s) {
+    append(out, static_cast<std::uint64_t>(s.size()));
+    out += s;
+}
+
+std::size_t result_bytes(const std::string &key, const Cached_result &result) {
+    return key.size() + sizeof(Cached_result) + result.hist.size() * 4 * sizeof(double) +
+           result.terminal.size() * sizeof(double);
+}
+
+} // namespace
+
+/** \brief 		The bytes the result of a run depends on, in a fixed order: a format version,
+*				the paths per Block_stream block, the scheme, the parameters as parameters_key()
+*				(term structure and local volatility surface included, bit for bit), N, ts, the
+*				seed and the variant.
+*
+*/
+std::string Run_descriptor::canonical() const {
+
+    std::string out{magic, sizeof(magic)};
+    append(out, static_cast<std::int64_t>(Block_stream::paths_per_block));
+    append(out, scheme);
+    append(out, parameters_key(params));
+    append(out, static_cast<std::int64_t>(num_sims));
+    append(out, static_cast<std::int64_t>(num_timesteps));
+    append(out, seed);
+    append(out, variant);
+    return out;
+}
+
+/** \brief      The 64-bit FNV-1a hash of canonical().
+*/
+std::uint64_t Run_descriptor::hash() const {
+
+    std::uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : canonical()) {
+        h = (h ^ c) * 1099511628211ULL;
+    }
+    return h;
+}
+
+/** \brief 		Opens a cache, indexing the result files already in directory (created if
+*				missing) from the most to the least recently used, and evicting the oldest when
+*				they exceed disk_bytes.
+*   \param 		directory - Where results are stored, or "" for a memory-only cache.
+*   \param      memory_bytes . disk_bytes - The bounds of the two levels.
+*   \param      keep_terminal - Whether producers should store the terminal slices.
+*
+*/
+Result_cache::Result_cache(std::string directory, std::size_t memory_bytes, std::size_t disk_bytes,
+                           bool keep_terminal)
+        : directory_{std::move(directory)}, memory_limit_{memory_bytes}, disk_limit_{disk_bytes},
+          keep_terminal_{keep_terminal} {
+
+    if (directory_.empty()) {
+        return;
+    }
+
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::create_directories(directory_, error);
+    if (error) {
+        std::cerr << "Error creating cache directory " << directory_ << ": " << error.message() << '\n';
+        exit(1);
+    }
+
+    std::vector<std::pair<fs::file_time_type, Disk_entry>> files;
+    for (const auto &file : fs::directory_iterator(directory_)) {
+        std::string name = file.path().filename().string();
+        if (file.is_regular_file() && name.size() == 20 && name.compare(16, 4, ".res") == 0) {
+            std::uint64_t hash = std::stoull(name.substr(0, 16), nullptr, 16);
+            files.push_back({file.last_write_time(), Disk_entry{hash, static_cast<std::size_t>(file.file_size())}});
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    for (const auto &f : files) {
+        disk_.push_back(f.second);
+        disk_index_[f.second.hash] = std::prev(disk_.end());
+        disk_bytes_ += f.second.bytes;
+    }
+    while (disk_bytes_ > disk_limit_ && !disk_.empty()) {
+        std::remove(path(disk_.back().hash).c_str());
+        disk_bytes_ -= disk_.back().bytes;
+        disk_index_.erase(disk_.back().hash);
+        disk_.pop_back();
+    }
+}
+
+/** \brief 		Looks a run up in memory, then on disk.
+*   \param 		descriptor - The run.
+*   \return		std::shared_ptr<const Cached_result> . Its result, or nullptr on a miss.
+*
+*/
+std::shared_ptr<const Cached_result> Result_cache::lookup(const Run_descriptor &descriptor) {
+
+    SDE_PHASE("cache.lookup");
+
+    std::string key = descriptor.canonical();
+    std::uint64_t hash = descriptor.hash();
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    auto it = memory_index_.find(hash);
+    if (it != memory_index_.end() && it->second->key == key) {
+        memory_.splice(memory_.begin(), memory_, it->second);
+        ++counts_.memory_hits;
+        return it->second->result;
+    }
+
+    if (!directory_.empty() && disk_index_.count(hash)) {
+        if (std::shared_ptr<const Cached_result> result = read_from_disk(hash, key)) {
+            ++counts_.disk_hits;
+            remember(hash, std::move(key), result);
+            return result;
+        }
+    }
+
+    ++counts_.misses;
+    return nullptr;
+}
+
+/** \brief      Stores the result of a run in memory and on disk. The terminal slice is dropped
+*               unless the cache keeps slices.
+*/
+void Result_cache::store(const Run_descriptor &descriptor, Cached_result result) {
+
+    SDE_PHASE("cache.store");
+
+    if (!keep_terminal_) {
+        result.terminal = std::valarray<double>();
+    }
+
+    std::string key = descriptor.canonical();
+    std::uint64_t hash = descriptor.hash();
+    auto shared = std::make_shared<const Cached_result>(std::move(result));
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    if (!directory_.empty()) {
+        write_to_disk(hash, key, *shared);
+    }
+    remember(hash, std::move(key), std::move(shared));
+}
+
+/** \brief      The hits and misses so far.
+*/
+Cache_counts Result_cache::counts() const {
+    std::lock_guard<std::mutex> lock{mutex_};
+    return counts_;
+}
+
+/** \brief      Puts a result at the front of the memory level, evicting from the back to stay
+*               within its bound. A result larger than the bound is not kept in memory.
+*/
+void Result_cache::remember(std::uint64_t hash, std::string key, std::shared_ptr<const Cached_result> result) {
+
+    auto it = memory_index_.find(hash);
+    if (it != memory_index_.end()) {
+        memory_bytes_ -= it->second->bytes;
+        memory_.erase(it->second);
+        memory_index_.erase(it);
+    }
+
+    std::size_t bytes = result_bytes(key, *result);
+    if (bytes > memory_limit_) {
+        return;
+    }
+
+    memory_.push_front(Memory_entry{hash, std::move(key), std::move(result), bytes});
+    memory_index_[hash] = memory_.begin();
+    memory_bytes_ += bytes;
+
+    while (memory_bytes_ > memory_limit_) {
+        memory_bytes_ -= memory_.back().bytes;
+        memory_index_.erase(memory_.back().hash);
+        memory_.pop_back();
+    }
+}
+
+/** \brief 		Writes a result file (to a temporary name, then renamed so that a reader never
+*				sees half a file) and evicts the least recently used files beyond the bound.
+*				The file holds the magic, the key, the statistics, the histogram and the
+*				terminal slice.
+*
+*/
+void Result_cache::write_to_disk(std::uint64_t hash, const std::string &key, const Cached_result &result) {
+
+    SDE_PHASE("io.cache_write");
+
+    std::string file = path(hash);
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        std::uint64_t key_size = key.size();
+        std::uint64_t hist_size = result.hist.size();
+        std::uint64_t terminal_size = result.terminal.size();
+
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char *>(&key_size), sizeof(key_size));
+        out.write(key.data(), key.size());
+        out.write(reinterpret_cast<const char *>(&result.stats), sizeof(result.stats));
+        out.write(reinterpret_cast<const char *>(&hist_size), sizeof(hist_size));
+        for (const auto &bin : result.hist) {
+            out.write(reinterpret_cast<const char *>(&bin.first), sizeof(bin.first));
+            out.write(reinterpret_cast<const char *>(&bin.second), sizeof(bin.second));
+        }
+        out.write(reinterpret_cast<const char *>(&terminal_size), sizeof(terminal_size));
+        if (terminal_size > 0) {
+            out.write(reinterpret_cast<const char *>(&result.terminal[0]), terminal_size * sizeof(double));
+        }
+        out.flush();
+        if (!out) {
+            std::cerr << "Error writing cache file " << tmp << '\n';
+            std::remove(tmp.c_str());
+            return;                                     //< the result is still cached in memory
+        }
+    }
+    if (std::rename(tmp.c_str(), file.c_str()) != 0) {
+        std::cerr << "Error renaming cache file " << tmp << " to " << file << '\n';
+        std::remove(tmp.c_str());
+        return;
+    }
+
+    auto it = disk_index_.find(hash);
+    if (it != disk_index_.end()) {
+        disk_bytes_ -= it->second->bytes;
+        disk_.erase(it->second);
+    }
+    std::size_t bytes = std::filesystem::file_size(file);
+    disk_.push_front(Disk_entry{hash, bytes});
+    disk_index_[hash] = disk_.begin();
+    disk_bytes_ += bytes;
+
+    while (disk_bytes_ > disk_limit_ && !disk_.empty()) {
+        std::remove(path(disk_.back().hash).c_str());
+        disk_bytes_ -= disk_.back().bytes;
+        disk_index_.erase(disk_.back().hash);
+        disk_.pop_back();
+    }
+}
+
+/** \brief      Reads a result file, if it holds key, and marks it most recently used.
+*   \return     std::shared_ptr<const Cached_result> . The result, or nullptr.
+*/
+std::shared_ptr<const Cached_result> Result_cache::read_from_disk(std::uint64_t hash, const std::string &key) {
+
+    SDE_PHASE("io.cache_read");
+
+    std::string file = path(hash);
+    std::ifstream in(file, std::ios::binary);
+    char file_magic[sizeof(magic)];
+    std::uint64_t key_size = 0;
+
+    in.read(file_magic, sizeof(file_magic));
+    in.read(reinterpret_cast<char *>(&key_size), sizeof(key_size));
+    if (!in || std::memcmp(file_magic, magic, sizeof(magic)) != 0 || key_size != key.size()) {
+        return nullptr;
+    }
+    std::string file_key(key_size, '\0');
+    in.read(&file_key[0], key_size);
+    if (file_key != key) {
+        return nullptr;                                 //< a hash collision
+    }
+
+    auto result = std::make_shared<Cached_result>();
+    std::uint64_t hist_size = 0;
+    std::uint64_t terminal_size = 0;
+
+    in.read(reinterpret_cast<char *>(&result->stats), sizeof(result->stats));
+    in.read(reinterpret_cast<char *>(&hist_size), sizeof(hist_size));
+    for (std::uint64_t i = 0; i < hist_size && in; ++i) {
+        double bin;
+        double density;
+        in.read(reinterpret_cast<char *>(&bin), sizeof(bin));
+        in.read(reinterpret_cast<char *>(&density), sizeof(density));
+        result->hist[bin] = density;
+    }
+    in.read(reinterpret_cast<char *>(&terminal_size), sizeof(terminal_size));
+    if (in && terminal_size > 0) {
+        result->terminal.resize(terminal_size);
+        in.read(reinterpret_cast<char *>(&result->terminal[0]), terminal_size * sizeof(double));
+    }
+    if (!in) {
+        return nullptr;
+    }
+
+    std::error_code error;
+    std::filesystem::last_write_time(file, std::filesystem::file_time_type::clock::now(), error);
+    disk_.splice(disk_.begin(), disk_, disk_index_[hash]);
+    return result;
+}
+
+/** \brief      The file of a result: its hash in 16 hex digits.
+*/
+std::string Result_cache::path(std::uint64_t hash) const {
+
+    char name[21];
+    std::snprintf(name, sizeof(name), "%016llx.res", static_cast<unsigned long long>(hash));
+    return directory_ + "/" + name;
+}
@@ -0,0 +1,121 @@
+#ifndef RESULT_CACHE_H_BQXLFWTN
+#define RESULT_CACHE_H_BQXLFWTN
+
+#include <map>
+#include <list>
+#include <valarray>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <unordered_map>
+
+#include "simulation.h"
+#include "empirical.h"
+
+/**
+ * \brief Everything a run's result depends on: the scheme, the parameters (term structure and local volatility
+ *        surface included), N, ts, the seed, and a variant naming the producer and any of its options that change
+ *        the result (e.g. "sweep bins=10 pool").
+ */
+struct Run_descriptor {
+    std::string scheme;
+    Parameters params;
+    long num_sims;
+    int num_timesteps;
+    std::uint64_t seed;
+    std::string variant;
+
+    std::string canonical() const;
+
+    std::uint64_t hash() const;
+};
+
+/**
+ * \brief The cached output of a run: the terminal statistics, the terminal density histogram, and the terminal
+ *        slice when the cache keeps slices (empty otherwise).
+ */
+struct Cached_result {
+    Running_stats stats;
+    std::map<double, double> hist;
+    std::valarray<double> terminal;
+};
+
+/**
+ * \brief Hit and miss counts of a Result_cache.
+ */
+struct Cache_counts {
+    long memory_hits = 0;
+    long disk_hits = 0;
+    long misses = 0;
+};
+
+/**
+ * \brief A content-addressed cache of run results, in memory and in a directory on disk.
+ *
+ * A result is addressed by the 64-bit FNV-1a hash of its descriptor's canonical bytes, and the bytes themselves are
+ * stored with it and compared on lookup, so a hash collision is a miss rather than a wrong answer. The runs cached
+ * here draw their variates deterministically from their seed and merge their statistics block by block in block
+ * order, so a hit is bit-identical to a recompute with any number of workers.
+ *
+ * Both levels are bounded in bytes and evict the least recently used result. The memory level holds shared
+ * results, so a hit copies nothing. A disk hit is promoted to memory. On disk each result is one file named by its
+ * hash, and recency is the file's modification time, refreshed on every hit, so the order survives restarts. An
+ * empty directory name keeps the cache in memory only. All members are safe to call from several threads.
+ */
+class Result_cache {
+public:
+    explicit Result_cache(std::string directory, std::size_t memory_bytes = std::size_t{256} << 20,
+                          std::size_t disk_bytes = std::size_t{4} << 30, bool keep_terminal = false);
+
+    std::shared_ptr<const Cached_result> lookup(const Run_descriptor &descriptor);
+
+    void store(const Run_descriptor &descriptor, Cached_result result);
+
+    bool keep_terminal() const { return keep_terminal_; }
+
+    Cache_counts counts() const;
+
+private:
+    /**
+     * \brief One result held in memory, most recently used first.
+     */
+    struct Memory_entry {
+        std::uint64_t hash;
+        std::string key;
+        std::shared_ptr<const Cached_result> result;
+        std::size_t bytes;
+    };
+
+    /**
+     * \brief One result file, most recently used first.
+     */
+    struct Disk_entry {
+        std::uint64_t hash;
+        std::size_t bytes;
+    };
+
+    void remember(std::uint64_t hash, std::string key, std::shared_ptr<const Cached_result> result);
+
+    void write_to_disk(std::uint64_t hash, const std::string &key, const Cached_result &result);
+
+    std::shared_ptr<const Cached_result> read_from_disk(std::uint64_t hash, const std::string &key);
+
+    std::string path(std::uint64_t hash) const;
+
+    std::string directory_;
+    std::size_t memory_limit_;
+    std::size_t disk_limit_;
+    bool keep_terminal_;
+
+    mutable std::mutex mutex_;
+    std::list<Memory_entry> memory_;
+    std::unordered_map<std::uint64_t, std::list<Memory_entry>::iterator> memory_index_;
+    std::size_t memory_bytes_ = 0;
+    std::list<Disk_entry> disk_;
+    std::unordered_map<std::uint64_t, std::list<Disk_entry>::iterator> disk_index_;
+    std::size_t disk_bytes_ = 0;
+    Cache_counts counts_;
+};
+
+#endif /* end of include guard: RESULT_CACHE_H_BQXLFWTN */
@@ -0,0 +1,219 @@
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+#include "scheduler.h"
+#include "instrument.h"
+
+namespace {
+
+thread_local const Scheduler *current_scheduler = nullptr;     //< Scheduler owning the calling thread
+thread_local int current_index = -1;                           //< Worker index of the calling thread
+
+} // namespace
+
+/**
+ * \brief The state of one parallel_range call: its function, grain and the number of tasks of the
+ *        range that have not finished yet.
+ */
+struct Scheduler::Group {
+    const std::function<void(long, long)> *fn;
+    long grain;
+    std::atomic<long> pending;
+};
+
+/** \brief 		Starts num_workers worker threads, each with an empty deque.
+*   \param 		num_workers - The number of worker threads, at least one.
+*   \param      pin - Where each worker pins itself when it starts.
+*
+*/
+Scheduler::Scheduler(int num_workers, Pin_policy pin) : pin_{pin} {
+
+    num_workers = std::max(num_workers, 1);
+    for (int i = 0; i < num_workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < num_workers; ++i) {
+        workers_[i]->thread = std::thread([this, i] { worker_loop(i); });
+    }
+}
+
+/** \brief 		Stops and joins the worker threads. Tasks still queued are not run.
+*/
+Scheduler::~Scheduler() {
+
+    {
+        std::lock_guard<std::mutex> lock{sleep_mutex_};
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto &w : workers_) {
+        w->thread.join();
+    }
+}
+
+/** \brief 		Index of the calling thread among this scheduler's workers.
+*   \return		int . The worker index, or -1 if the caller is not one of its workers.
+*/
+int Scheduler::worker_index() const {
+    return current_scheduler == this ? current_index : -1;
+}
+
+/** \brief 		Calls fn(first_i, count_i) over sub-ranges that together cover [first, first+count),
+*				each at most grain items long, on the worker threads. Returns when all are done.
+*   \param 		first . count - The range of work items.
+*   \param      grain - The largest sub-range handed to fn. Sub-ranges start at first + a multiple
+*				of a power-of-two fraction of count, so pass counts in units that fn may split
+*				freely (e.g. blocks of paths).
+*   \param      fn - Called once per sub-range, possibly concurrently.
+*
+*/
+void Scheduler::parallel_range(long first, long count, long grain, const std::function<void(long, long)> &fn) {
+
+    if (count <= 0) {
+        return;
+    }
+
+    Group group{&fn, std::max(grain, 1L), {1}};
+    Task root{first, count, &group};
+    int self = worker_index();
+
+    if (self >= 0) {
+        run(self, root);        //< Splits, leaving the upper halves to be stolen
+    } else {
+        push(-1, root);
+    }
+
+    wait_for(group);
+}
+
+/** \brief 		Calls fn(i) for i in [0, count) on the worker threads, one task per index.
+*/
+void Scheduler::parallel_for(int count, const std::function<void(int)> &fn) {
+    parallel_range(0, count, 1, [&fn](long first, long n) {
+        for (long i = first; i < first + n; ++i) {
+            fn(static_cast<int>(i));
+        }
+    });
+}
+
+void Scheduler::worker_loop(int index) {
+
+    current_scheduler = this;
+    current_index = index;
+    pin_current_thread(pin_, index);
+
+    Task task;
+    while (true) {
+        if (pop_or_steal(index, task)) {
+            run(index, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{sleep_mutex_};
+        wake_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        if (stopping_) {
+            return;
+        }
+    }
+}
+
+/** \brief 		Pushes a task on the back of a worker's deque. External callers (worker < 0)
+*				spread their tasks round robin.
+*/
+void Scheduler::push(int worker, Task task) {
+
+    if (worker < 0) {
+        worker = static_cast<int>(next_victim_++ % workers_.size());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{workers_[worker]->mutex};
+        workers_[worker]->tasks.push_back(task);
+    }
+    {
+        std::lock_guard<std::mutex> lock{sleep_mutex_};     //< Orders the increment against sleepers' checks
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+/** \brief 		Takes the newest task of the worker's own deque or, failing that, the oldest task
+*				of another worker's deque. Old tasks are the largest halves of a split range.
+*/
+bool Scheduler::pop_or_steal(int worker, Task &task) {
+
+    if (queued_ == 0) {
+        return false;
+    }
+
+    int n = static_cast<int>(workers_.size());
+    for (int k = 0; k < n; ++k) {
+        Worker &w = *workers_[(worker + k) % n];
+        std::lock_guard<std::mutex> lock{w.mutex};
+
+        if (w.tasks.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            task = w.tasks.back();
+            w.tasks.pop_back();
+        } else {
+            task = w.tasks.front();
+            w.tasks.pop_front();
+            SDE_COUNT("scheduler.steals", 1);
+        }
+        --queued_;
+        return true;
+    }
+
+    return false;
+}
+
+/** \brief 		Runs a task, first halving it until it is no larger than its grain. Each upper
+*				half goes on the worker's deque where an idle worker can steal it.
+*/
+void Scheduler::run(int worker, Task task) {
+
+    Group &group = *task.group;
+
+    while (task.count > group.grain) {
+        long upper = task.count / 2;
+        task.count -= upper;
+        ++group.pending;
+        push(worker, Task{task.first + task.count, upper, &group});
+    }
+
+    (*group.fn)(task.first, task.count);
+
+    if (--group.pending == 0) {
+        std::lock_guard<std::mutex> lock{sleep_mutex_};
+        wake_.notify_all();
+    }
+}
+
+/** \brief 		Waits for every task of a group to finish. A worker keeps running queued tasks
+*				while it waits; any other thread sleeps.
+*/
+void Scheduler::wait_for(Group &group) {
+
+    int self = worker_index();
+    Task task;
+
+    while (group.pending > 0) {
+        if (self >= 0 && pop_or_steal(self, task)) {
+            run(self, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock{sleep_mutex_};
+        wake_.wait(lock, [&] { return group.pending == 0 || (self >= 0 && queued_ > 0); });
+    }
+}
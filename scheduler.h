@@ -0,0 +1,203 @@
+#ifndef SCHEDULER_H_FYQDHWSE
+#define SCHEDULER_H_FYQDHWSE
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <type_traits>
+#include <condition_variable>
+
+#include "myrandom.h"
+#include "checkpoint.h"
+#include "placement.h"
+
+/**
+ * \brief Work-stealing scheduler shared by the simulation drivers.
+ *
+ * Each worker thread owns a deque of tasks. It pushes and pops at the back of its own deque and, when that
+ * is empty, steals from the front of another worker's deque. A task covers a range of work items (paths,
+ * scenarios, resolutions). A range larger than its grain is split in half: the upper half is pushed where
+ * it can be stolen and the lower half is run or split further. Large jobs therefore spread over idle
+ * workers, while small jobs cost one task each.
+ *
+ * parallel_range() blocks until the whole range is done. Called from inside a task it runs other tasks
+ * while it waits, so drivers may nest (e.g. a sweep of scenarios each split over paths).
+ *
+ * Which worker runs which part of a range depends on stealing, so results are kept per work item (e.g. one
+ * Running_stats per block) and merged in item order once parallel_range() returns: merging per-worker
+ * totals would make floating-point results depend on the schedule. Per-worker scratch state (RNG streams)
+ * is kept in a Per_worker, which each worker allocates for itself.
+ *
+ * Workers are pinned to cores or NUMA nodes by the pin policy, placement().pin (SDE_PIN) by default.
+ */
+class Scheduler {
+public:
+    explicit Scheduler(int num_workers = static_cast<int>(std::thread::hardware_concurrency()),
+                       Pin_policy pin = placement().pin);
+
+    ~Scheduler();
+
+    Scheduler(const Scheduler &) = delete;
+
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    void parallel_range(long first, long count, long grain, const std::function<void(long, long)> &fn);
+
+    void parallel_for(int count, const std::function<void(int)> &fn);
+
+    int num_workers() const { return static_cast<int>(workers_.size()); }
+
+    int worker_index() const;
+
+private:
+    struct Group;
+
+    /**
+     * \brief The range [first, first+count) of one parallel_range call.
+     */
+    struct Task {
+        long first;
+        long count;
+        Group *group;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void worker_loop(int index);
+
+    void push(int worker, Task task);
+
+    bool pop_or_steal(int worker, Task &task);
+
+    void run(int worker, Task task);
+
+    void wait_for(Group &group);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<long> queued_{0};           //!< Tasks sitting in any deque
+    std::atomic<unsigned> next_victim_{0};  //!< Round robin start for external pushes
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;          //!< Signalled when tasks are queued or a group finishes
+    bool stopping_ = false;
+    Pin_policy pin_;
+};
+
+/**
+ * \brief One T per worker of a scheduler, each default-constructed by its worker on first use.
+ *
+ * A vector of T built by the calling thread puts every worker's state on that thread's NUMA node, packed
+ * next to its neighbours'. Here each worker allocates its own, so the state it writes at every step (e.g. the
+ * 2.5 KB engine of a Block_stream) is on its node and shares no cache line with another worker's.
+ */
+template <typename T>
+class Per_worker {
+public:
+    explicit Per_worker(const Scheduler &scheduler) : scheduler_{scheduler}, items_(scheduler.num_workers()) {}
+
+    T &local() {
+        std::unique_ptr<T> &item = items_[scheduler_.worker_index()];
+        if (!item) {
+            item = std::make_unique<T>();
+        }
+        return *item;
+    }
+
+private:
+    const Scheduler &scheduler_;
+    std::vector<std::unique_ptr<T>> items_;
+};
+
+/** \brief 		Runs paths(first, n, draw, stats) over N paths split into blocks of
+*				Block_stream::paths_per_block on the scheduler. Each block seeks a per-worker
+*				Block_stream to (seed, block), and draw(out, m) writes its next m variates to out.
+*				Statistics are kept per block and merged in block order, so the result is bit
+*				identical whatever the number of workers.
+*
+*				With a checkpoint the blocks are run in segments of blocks_per_checkpoint. After
+*				each segment the merged statistics and the number of blocks done are saved on a
+*				writer thread while the next segment runs, and a run that finds its checkpoint
+*				resumes after the last saved block. A block depends only on (seed, block), and
+*				the merge order is unchanged, so a resumed run is bit identical to an
+*				uninterrupted one.
+*   \param      paths - Simulates the n paths starting at path first into stats.
+*   \param      checkpoint - Where to save and resume progress, or nullptr.
+*   \param      run - With a checkpoint, the exact description of what paths computes (payoff,
+*				scheme, parameters, steps...), which a resumed checkpoint must match.
+*   \return		Stats . The merged statistics, Stats must provide merge().
+*
+*/
+template <typename Stats, typename Paths>
+Stats parallel_blocks(Scheduler &scheduler, long N, std::uint64_t seed, Paths paths,
+                      const Checkpoint *checkpoint = nullptr, const std::string &run = "") {
+
+    static_assert(std::is_trivially_copyable<Stats>::value, "checkpoints save the statistics byte for byte");
+
+    if (checkpoint && run.empty()) {
+        std::cerr << "Error. A checkpointed run needs a description of what it computes." << '\n';
+        exit(1);
+    }
+
+    long num_blocks = (N + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+    long segment = checkpoint ? std::max(1L, checkpoint->blocks_per_checkpoint) : num_blocks;
+    Per_worker<Block_stream> streams(scheduler);
+    std::vector<Stats> block_stats(std::min(segment, num_blocks));
+    std::future<void> pending;                  //< The checkpoint being written
+    Stats stats;
+    long done = 0;
+
+    Checkpoint_state saved;
+    if (checkpoint && load_checkpoint(*checkpoint, run, N, seed, sizeof(Stats), saved)) {
+        done = saved.blocks_done;
+        std::memcpy(&stats, saved.stats.data(), sizeof(Stats));
+    }
+
+    while (done < num_blocks) {
+        long count = std::min(segment, num_blocks - done);
+        std::fill(block_stats.begin(), block_stats.begin() + count, Stats{});
+
+        scheduler.parallel_range(done, count, 1, [&](long first_block, long blocks) {
+            Block_stream &stream = streams.local();
+            for (long b = first_block; b < first_block + blocks; ++b) {
+                long first = b * Block_stream::paths_per_block;
+                int n = static_cast<int>(std::min<long>(Block_stream::paths_per_block, N - first));
+                stream.seek(seed, b);
+                paths(first, n, [&](double *out, int m) { stream.fill(out, m); }, block_stats[b - done]);
+            }
+        });
+
+        for (long b = 0; b < count; ++b) {
+            stats.merge(block_stats[b]);
+        }
+        done += count;
+
+        if (checkpoint) {
+            if (pending.valid()) {
+                pending.get();
+            }
+            Checkpoint_state state{done, std::vector<char>(sizeof(Stats))};
+            std::memcpy(state.stats.data(), &stats, sizeof(Stats));
+            pending = std::async(std::launch::async, save_checkpoint, *checkpoint, run, N, seed, std::move(state));
+        }
+    }
+
+    if (pending.valid()) {
+        pending.get();
+    }
+    return stats;
+}
+
+#endif /* end of include guard: SCHEDULER_H_FYQDHWSE */
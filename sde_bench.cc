@@ -0,0 +1,387 @@
+/**
+ * \file        sde_bench.cc
+ * \brief       Benchmark suite for the schemes, the Gaussian variate generators and the empirical statistics.
+ *              Every benchmark is swept over the number of paths N and the number of time steps ts. Results are
+ *              printed as a table and written as JSON so that two builds can be compared.
+ *
+ *              Usage: ./sde_bench [results.json] [--quick]
+ */
+#include <valarray>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <numeric>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <filesystem>
+#include <cmath>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+#include "placement.h"
+#include "result_cache.h"
+
+#ifndef SDE_BENCH_FLAGS
+#define SDE_BENCH_FLAGS "unknown"
+#endif
+
+namespace {
+
+/**
+ * \brief One benchmark measurement. Rates are derived from the best (minimum) repetition.
+ */
+struct Bench_result {
+    std::string name;
+    std::string kind;           //!< "scheme", "rng", "statistic", "memory" or "cache"
+    int N;
+    int ts;
+    int reps;
+    double best_ns;             //!< Fastest repetition, nanoseconds
+    double median_ns;           //!< Median repetition, nanoseconds
+    double items;               //!< Path-steps (schemes) or values (rngs, statistics) per repetition
+    double bytes;               //!< Bytes produced or consumed per repetition
+};
+
+volatile double sink;           //!< Keeps the optimiser from discarding benchmarked work
+
+/** \brief      Runs fn repeatedly, at least three times and until 0.2s have been spent.
+*   \return     The wall-clock time of each repetition in nanoseconds.
+*/
+std::vector<double> time_reps(const std::function<void()> &fn) {
+
+    using clock = std::chrono::steady_clock;
+    std::vector<double> times;
+    double total = 0;
+
+    while (times.size() < 3 || (total < 2e8 && times.size() < 1000)) {
+        auto start = clock::now();
+        fn();
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+        times.push_back(ns);
+        total += ns;
+    }
+
+    return times;
+}
+
+Bench_result make_result(std::string name, std::string kind, int N, int ts, std::vector<double> times,
+                         double items, double bytes) {
+    std::sort(times.begin(), times.end());
+    return Bench_result{std::move(name), std::move(kind), N, ts, static_cast<int>(times.size()),
+                        times.front(), times[times.size() / 2], items, bytes};
+}
+
+/** \brief      The default parameters with piecewise constant mu(t) and sigma(t) over four quarters.
+*/
+Parameters term_structure() {
+
+    Parameters p;
+    p.term_times = {0.25, 0.5, 0.75, 1.0};
+    p.term_mu = {0.03, 0.04, 0.05, 0.06};
+    p.term_sigma = {0.3, 0.25, 0.2, 0.18};
+    return p;
+}
+
+/** \brief      The default parameters with a skewed local volatility surface, sigma(t, S) =
+*               0.2*sqrt(100/S)*(1 + 0.1*t) on 3 time rows and 61 spot nodes from 40 to 250.
+*/
+Parameters local_vol_surface() {
+
+    const std::vector<double> times{0.0, 0.5, 1.0};
+    const int num_spots = 61;
+    const double spot_min = 40;
+    const double spot_max = 250;
+    std::vector<double> vols;
+    for (double t : times) {
+        for (int j = 0; j < num_spots; ++j) {
+            double S = spot_min + j * (spot_max - spot_min) / (num_spots - 1);
+            vols.push_back(0.2 * std::sqrt(100 / S) * (1 + 0.1 * t));
+        }
+    }
+
+    Parameters p;
+    p.local_vol = std::make_shared<const Local_vol>(times, spot_min, spot_max, num_spots, vols);
+    return p;
+}
+
+/** \brief      Times the full construction of a scheme. The variates are generated once outside
+*               the timed region and read from the start by every repetition. With an observation schedule,
+*               which must contain ts, only the observed steps are stored. coefficients selects
+*               constant, term-structured or local volatility coefficients. With a scheduler the
+*               paths are stepped in blocks on its workers, into slices first touched by them.
+*/
+template<typename Scheme>
+Bench_result bench_scheme(const std::string &name, int N, int ts, std::vector<int> observation_steps = {},
+                          const Parameters &coefficients = Parameters{}, Scheduler *scheduler = nullptr) {
+
+    Parameters params = coefficients;
+    const Gaussian_RNs rng{N * ts};
+    std::size_t stored = observation_steps.empty() ? ts + 1 : observation_steps.size() + 1;
+
+    auto times = time_reps([&] {
+        Scheme s{params, N, ts, rng.cursor(), observation_steps, scheduler};
+        sink = s.get_valarray_at_step(ts)[0];
+    });
+
+    return make_result(name, "scheme", N, ts, times, static_cast<double>(N) * ts,
+                       static_cast<double>(N) * stored * sizeof(double));
+}
+
+template<typename Generator>
+Bench_result bench_rng(const std::string &name, int N, int ts) {
+
+    int n = N * ts;
+    auto times = time_reps([&] {
+        Generator rng{n};
+        sink = rng();
+    });
+
+    return make_result(name, "rng", N, ts, times, n, static_cast<double>(n) * sizeof(double));
+}
+
+/** \brief      Times draining one pool through a Shared_stream from every hardware thread at once,
+*               each reserving blocks of Block_stream::paths_per_block variates and summing them.
+*/
+Bench_result bench_shared_stream(const std::string &name, int N, int ts) {
+
+    int n = N * ts;
+    const Gaussian_RNs pool{n};
+    Shared_stream stream{pool};
+    unsigned num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    auto times = time_reps([&] {
+        stream.reset_to_start();
+        std::vector<std::thread> threads;
+        std::vector<double> sums(num_threads);
+        for (unsigned t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&, t] {
+                for (Variate_block b = stream.reserve(Block_stream::paths_per_block); b.size > 0;
+                     b = stream.reserve(Block_stream::paths_per_block)) {
+                    sums[t] += std::accumulate(b.data, b.data + b.size, 0.0);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        sink = std::accumulate(sums.begin(), sums.end(), 0.0);
+    });
+
+    return make_result(name, "rng", N, ts, times, n, static_cast<double>(n) * sizeof(double));
+}
+
+/** \brief      Times one Euler step of N paths held in memory, split over the hardware threads in
+*               Block_stream blocks. The prices and variates are either allocated and zeroed by the
+*               main thread, as a std::vector is, or allocated by Path_allocator with the given
+*               huge pages and first-touched by the workers (pinned to cores), and so spread over
+*               the NUMA nodes of the workers that step them.
+*/
+Bench_result bench_placement(const std::string &name, int N, bool worker_touch, Huge_pages pages) {
+
+    Scheduler scheduler{static_cast<int>(std::max(1u, std::thread::hardware_concurrency())),
+                        worker_touch ? Pin_policy::cores : Pin_policy::none};
+    std::vector<double> main_prices;
+    std::vector<double> main_rans;
+    double *prices;
+    double *rans;
+
+    if (worker_touch) {
+        prices = static_cast<double *>(allocate_pages(N * sizeof(double), pages));
+        rans = static_cast<double *>(allocate_pages(N * sizeof(double), pages));
+        first_touch(prices, N, scheduler);
+        first_touch(rans, N, scheduler);
+    } else {
+        main_prices.resize(N);
+        main_rans.resize(N);
+        prices = main_prices.data();
+        rans = main_rans.data();
+    }
+    std::fill(prices, prices + N, 100.0);       //< rewrites the pages wherever they were placed
+    std::fill(rans, rans + N, 0.5);
+
+    const long block = Block_stream::paths_per_block;
+    const double drift = 0.05 / 252;
+    const double vol = 0.2 * std::sqrt(1.0 / 252);
+    auto times = time_reps([&] {
+        scheduler.parallel_range(0, (N + block - 1) / block, 1, [&](long first, long count) {
+            long end = std::min<long>(N, (first + count) * block);
+            for (long i = first * block; i < end; ++i) {
+                prices[i] += prices[i] * (drift + vol * rans[i]);
+            }
+        });
+    });
+    sink = prices[N / 2];
+
+    if (worker_touch) {
+        free_pages(prices, N * sizeof(double));
+        free_pages(rans, N * sizeof(double));
+    }
+    return make_result(name, "memory", N, 1, times, N, 3.0 * N * sizeof(double));
+}
+
+/** \brief      Times a Result_cache hit on the statistics and histogram of an N path run, from
+*               memory or, with no room in memory, from the disk store in a scratch directory.
+*/
+Bench_result bench_cache(const std::string &name, int N, bool from_disk) {
+
+    std::string directory = (std::filesystem::temp_directory_path() / "sde_bench_cache").string();
+    Result_cache cache{directory, from_disk ? 0 : std::size_t{1} << 20};
+    Parameters params;
+    Run_descriptor run{"exact", params, N, 1, 0, "bench"};
+    const Gaussian_RNs rng{N};
+    Exact_path ex{params, N, 1, rng};
+    const std::valarray<double> &terminal = ex.get_valarray_at_step(1);
+    Running_stats stats;
+    stats.add(terminal);
+    cache.store(run, Cached_result{stats, create_density_hist(terminal), {}});
+
+    auto times = time_reps([&] { sink = cache.lookup(run)->stats.mean(); });
+
+    std::filesystem::remove_all(directory);
+    return make_result(name, "cache", N, 1, times, 1, 0);
+}
+
+/** \brief      Times a statistic over the terminal slice of an exact simulation.
+*/
+Bench_result bench_statistic(const std::string &name, int N, int ts,
+                             const std::function<double(const std::valarray<double> &)> &stat) {
+
+    Parameters params;
+    const Gaussian_RNs rng{N * ts};
+    Exact_path ex{params, N, ts, rng};
+    const std::valarray<double> &terminal = ex.get_valarray_at_step(ts);
+
+    auto times = time_reps([&] { sink = stat(terminal); });
+
+    return make_result(name, "statistic", N, ts, times, N, static_cast<double>(N) * sizeof(double));
+}
+
+std::string json_escape(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+void write_json(const std::vector<Bench_result> &results, const std::string &filename) {
+
+    std::ofstream outfile(filename);
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening outfile." << '\n';
+        exit(1);
+    }
+
+    outfile << std::setprecision(10);
+    outfile << "{\n  \"compiler\": \"" << json_escape(__VERSION__) << "\",\n"
+            << "  \"flags\": \"" << json_escape(SDE_BENCH_FLAGS) << "\",\n"
+            << "  \"results\": [\n";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Bench_result &r = results[i];
+        double seconds = r.best_ns * 1e-9;
+        outfile << "    {\"name\": \"" << r.name << "\", \"kind\": \"" << r.kind << "\", \"N\": " << r.N
+                << ", \"ts\": " << r.ts << ", \"reps\": " << r.reps << ", \"best_ns\": " << r.best_ns
+                << ", \"median_ns\": " << r.median_ns << ", \"items_per_second\": " << r.items / seconds
+                << ", \"ns_per_item\": " << r.best_ns / r.items << ", \"bytes_per_second\": " << r.bytes / seconds
+                << "}" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+
+    outfile << "  ]\n}\n";
+}
+
+void print_row(std::ostream &out, const Bench_result &r) {
+    double seconds = r.best_ns * 1e-9;
+    out << std::left << std::setw(18) << r.name << std::right << std::setw(9) << r.N << std::setw(6) << r.ts
+        << std::setw(14) << std::setprecision(4) << r.items / seconds
+        << std::setw(12) << r.best_ns / r.items
+        << std::setw(12) << r.bytes / seconds / 1e9 << '\n';
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+
+    std::string filename{"bench_results.json"};
+    bool quick{false};
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--quick") {
+            quick = true;
+        } else {
+            filename = arg;
+        }
+    }
+
+    const std::vector<int> sims = quick ? std::vector<int>{1'000, 10'000} : std::vector<int>{1'000, 10'000, 100'000};
+    const std::vector<int> steps = quick ? std::vector<int>{1, 10} : std::vector<int>{1, 10, 100};
+    std::vector<Bench_result> results;
+
+    // The constructors and destructors report to std::cout, which would dominate the timings. Silence
+    // std::cout for the whole run and print the table through the console's stream buffer instead.
+    std::ostream console{std::cout.rdbuf()};
+    std::cout.setstate(std::ios_base::badbit);
+
+    console << std::left << std::setw(18) << "benchmark" << std::right << std::setw(9) << "N" << std::setw(6)
+           << "ts" << std::setw(14) << "items/s" << std::setw(12) << "ns/item" << std::setw(12) << "GB/s" << '\n';
+
+    auto record = [&results, &console](Bench_result r) {
+        print_row(console, r);
+        results.push_back(std::move(r));
+    };
+
+    Scheduler scheduler{static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))};
+
+    for (int N : sims) {
+        for (int ts : steps) {
+            record(bench_scheme<Exact_path>("Exact_path", N, ts));
+            record(bench_scheme<Exact_path>("Exact_path+blocks", N, ts, {}, Parameters{}, &scheduler));
+            record(bench_scheme<Exact_path>("Exact_path@T", N, ts, {ts}));
+            record(bench_scheme<Milstein>("Milstein", N, ts));
+            record(bench_scheme<Euler_Maruyama>("Euler_Maruyama", N, ts));
+            record(bench_scheme<Exact_path>("Exact_path+term", N, ts, {}, term_structure()));
+            record(bench_scheme<Exact_path>("Exact_path+LV", N, ts, {}, local_vol_surface()));
+            record(bench_scheme<Milstein>("Milstein+term", N, ts, {}, term_structure()));
+            record(bench_scheme<Milstein>("Milstein+LV", N, ts, {}, local_vol_surface()));
+
+            record(bench_rng<Gaussian_RNs>("Gaussian_RNs", N, ts));
+            record(bench_rng<BOOST_Fibonacci>("BOOST_Fibonacci", N, ts));
+            record(bench_shared_stream("Shared_stream", N, ts));
+            if (N * ts <= 10'000) {     //< Sobol is limited to the 10'000 tabulated points
+                record(bench_rng<Sobol>("Sobol", N, ts));
+            }
+        }
+
+        record(bench_statistic("create_density_hist", N, 1,
+                               [](const std::valarray<double> &v) { return create_density_hist(v).size(); }));
+        record(bench_statistic("expected_value", N, 1, expected_value));
+        record(bench_statistic("variance", N, 1, variance));
+
+        record(bench_cache("Cache_hit_memory", N, false));
+        record(bench_cache("Cache_hit_disk", N, true));
+    }
+
+    // Large N only: the buffers must be far bigger than the last level cache to measure memory bandwidth.
+    const int big_N = quick ? 1 << 22 : 1 << 25;
+    record(bench_placement("Touch_main", big_N, false, Huge_pages::none));
+    record(bench_placement("Touch_worker", big_N, true, Huge_pages::none));
+    record(bench_placement("Touch_worker+THP", big_N, true, Huge_pages::transparent));
+    record(bench_placement("Touch_worker+HTLB", big_N, true, Huge_pages::explicit_pages));
+
+    write_json(results, filename);
+    console << "\nResults written to " << filename << '\n';
+
+    return 0;
+}
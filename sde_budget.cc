@@ -0,0 +1,67 @@
+/**
+ * \file        sde_budget.cc
+ * \brief       Plans a run of the exact, Milstein and Euler-Maruyama schemes under a memory budget, prints the
+ *              estimated memory and time of every execution and the one chosen, then runs it and prints the mean
+ *              and variance of each scheme at the last stored step and, when several slices are kept, the mean
+ *              of each scheme at the first stored step read back from the run.
+ *
+ *              Usage: ./sde_budget [num_sims] [num_timesteps] [budget_mb] [output] [num_threads]
+ *              output is terminal, monthly (every 21st step), full or stats (terminal statistics only).
+ */
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+
+#include "simulation.h"
+#include "planner.h"
+#include "budget.h"
+#include "scheduler.h"
+
+int main(int argc, char *argv[]) {
+    const long NUM_SIMS{argc > 1 ? std::stol(argv[1]) : 1'000'000};
+    const int NUM_TIMESTEPS{argc > 2 ? std::stoi(argv[2]) : 252};
+    const std::size_t BUDGET{(argc > 3 ? std::stoul(argv[3]) : 1024) << 20};
+    const std::string OUTPUT{argc > 4 ? argv[4] : "terminal"};
+    const int NUM_THREADS{argc > 5 ? std::stoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency())};
+    const std::uint64_t SEED{20190324};
+    Parameters params;
+
+    Run_request request{{"exact", "milstein", "euler_maruyama"}, NUM_SIMS, NUM_TIMESTEPS, Output_need::terminal, {},
+                        OUTPUT != "stats", NUM_THREADS};
+    if (OUTPUT == "full") {
+        request.need = Output_need::full_path;
+    } else if (OUTPUT == "monthly") {
+        request.need = Output_need::schedule;
+        for (int k = 21; k <= NUM_TIMESTEPS; k += 21) {
+            request.observation_steps.push_back(k);
+        }
+    }
+
+    Budget_plan plan = plan_for_budget(request, BUDGET);
+    std::cout << '\n';
+    print_budget_plan(plan, std::cout);
+    std::cout << '\n';
+
+    Scheduler scheduler{NUM_THREADS};
+    auto start = std::chrono::steady_clock::now();
+    Budget_run run = run_budget_plan(plan, params, SEED, scheduler);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << '\n' << std::setprecision(6);
+    for (std::size_t s = 0; s < run.stats.size(); ++s) {
+        std::cout << "  " << std::setw(16) << std::left << request.schemes[s] << std::right << "mean "
+                  << run.stats[s].mean() << ", variance " << run.stats[s].variance();
+        if (request.keep_slices && plan.stored_steps.size() > 1) {
+            Running_stats first;
+            first.add(run.slice(s, 0));
+            std::cout << "; mean at step " << plan.stored_steps[0] << " " << first.mean();
+        }
+        std::cout << '\n';
+    }
+    std::cout << "  time " << elapsed.count() << " s (estimated " << plan.chosen_estimate().seconds << " s)\n\n";
+
+    return 0;
+}
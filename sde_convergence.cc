@@ -0,0 +1,58 @@
+/**
+ * \file        sde_convergence.cc
+ * \brief       Strong and weak convergence study of the Euler-Maruyama and Milstein schemes against the exact
+ *              solution for GBM. The finest Brownian increments are drawn once and reused at every resolution.
+ *
+ *              Usage: ./sde_convergence [num_sims] [finest_timesteps]
+ *              The resolutions are finest_timesteps, finest_timesteps/2, ..., 1 (finest_timesteps defaults to 256).
+ */
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+#include "simulation.h"
+#include "convergence.h"
+#include "scheduler.h"
+
+int main(int argc, char *argv[]) {
+    const int NUM_SIMS{argc > 1 ? std::stoi(argv[1]) : 10'000};
+    const int FINEST_TIMESTEPS{argc > 2 ? std::stoi(argv[2]) : 256};
+    Parameters params;
+    std::stringstream outfile;
+
+    std::vector<int> timesteps;
+    for (int ts = FINEST_TIMESTEPS; ts >= 1; ts /= 2) {
+        timesteps.push_back(ts);
+        if (ts % 2 != 0) {
+            break;
+        }
+    }
+
+    Scheduler scheduler;
+    Convergence_study study = run_convergence_study(params, NUM_SIMS, timesteps, scheduler);
+
+    std::cout << '\n' << std::setw(10) << "timesteps" << std::setw(12) << "delta_t"
+              << std::setw(24) << "EM strong" << std::setw(24) << "EM weak"
+              << std::setw(24) << "Milstein strong" << std::setw(24) << "Milstein weak" << '\n';
+
+    for (const auto &pt : study.points) {
+        auto cell = [](const Error_estimate &e) {
+            std::stringstream ss;
+            ss << std::setprecision(4) << e.value << " +/- " << e.half_width;
+            return ss.str();
+        };
+        std::cout << std::setw(10) << pt.num_timesteps << std::setw(12) << std::setprecision(4) << pt.delta_t
+                  << std::setw(24) << cell(pt.em_strong) << std::setw(24) << cell(pt.em_weak)
+                  << std::setw(24) << cell(pt.m_strong) << std::setw(24) << cell(pt.m_weak) << '\n';
+    }
+
+    std::cout << "\nEstimated orders: EM strong " << study.em_strong_order << ", EM weak " << study.em_weak_order
+              << ", Milstein strong " << study.m_strong_order << ", Milstein weak " << study.m_weak_order << "\n\n";
+
+    outfile << "convergence_time_" << params.T << "_sims_" << NUM_SIMS << ".txt";
+    write_convergence_to_file(study, outfile.str());
+
+    return 0;
+}
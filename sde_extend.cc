@@ -0,0 +1,134 @@
+/**
+ * \file        sde_extend.cc
+ * \brief       Grows a lazy exact simulation in place, first to twice the horizon and then to more paths, while statistics
+ *              and histograms of the prices at T and 2T are fed through step sinks. Checks the grown run against the
+ *              same paths simulated from scratch and prints the time of each extension next to the from-scratch time.
+ *
+ *              Usage: ./sde_extend [num_sims] [num_timesteps] [path_factor]
+ *              The run starts with num_sims paths over num_timesteps steps to T, is extended to 2T and then to
+ *              path_factor x num_sims paths (default 4).
+ */
+#include <vector>
+#include <valarray>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <utility>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "lazy.h"
+
+namespace {
+
+/**
+ * \brief The running statistics and histogram of the prices at one step, fed through a sink.
+ */
+struct Step_summary {
+    Running_stats stats;
+    Running_histogram hist;
+
+    void add(const std::valarray<double> &prices) {
+        stats.add(prices);
+        hist.add(prices);
+    }
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    const int NUM_SIMS{argc > 1 ? std::stoi(argv[1]) : 10'000};
+    const int NUM_TIMESTEPS{argc > 2 ? std::stoi(argv[2]) : 252};
+    const int PATH_FACTOR{argc > 3 ? std::stoi(argv[3]) : 4};
+    const std::uint64_t SEED{20190324};
+    const int added_paths = (PATH_FACTOR - 1) * NUM_SIMS;
+    Parameters params;
+
+    if (PATH_FACTOR < 2) {
+        std::cerr << "Error. The path factor must be at least 2." << '\n';
+        return 1;
+    }
+
+    // The first pass and the added steps read NUM_SIMS variates per step, the added paths read theirs after them.
+    const Gaussian_RNs pool{2 * NUM_TIMESTEPS * (NUM_SIMS + added_paths), SEED};
+    const double bin_width = params.S0 / 100;         //< fixed, so batches and runs can be compared bin for bin
+    Step_summary at_T{Running_stats{}, Running_histogram{100, bin_width}};
+    Step_summary at_2T{Running_stats{}, Running_histogram{100, bin_width}};
+    double times[3];
+
+    auto start = std::chrono::steady_clock::now();
+    Lazy_simulation grown{Simulation_spec{"exact", params, NUM_SIMS, NUM_TIMESTEPS, pool.cursor(), {NUM_TIMESTEPS}}};
+    grown.add_sink(NUM_TIMESTEPS, [&](const std::valarray<double> &prices) { at_T.add(prices); });
+    grown.advance_to(NUM_TIMESTEPS);
+    times[0] = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    grown.add_steps(NUM_TIMESTEPS);
+    grown.add_sink(2 * NUM_TIMESTEPS, [&](const std::valarray<double> &prices) { at_2T.add(prices); });
+    grown.advance_to(2 * NUM_TIMESTEPS);
+    times[1] = seconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    grown.add_paths(added_paths);
+    times[2] = seconds_since(start);
+
+    // The same paths from scratch: the first NUM_SIMS over 2T, then the added ones from where their variates start.
+    Parameters longer = params;
+    longer.T = params.t0 + 2 * (params.T - params.t0);
+    std::vector<int> kept{NUM_TIMESTEPS, 2 * NUM_TIMESTEPS};
+
+    start = std::chrono::steady_clock::now();
+    Lazy_simulation first{Simulation_spec{"exact", longer, NUM_SIMS, 2 * NUM_TIMESTEPS, pool.cursor(), kept}};
+    Lazy_simulation added{Simulation_spec{"exact", longer, added_paths, 2 * NUM_TIMESTEPS,
+                                          pool.cursor(2 * NUM_TIMESTEPS * NUM_SIMS), kept}};
+    Step_summary scratch_T{Running_stats{}, Running_histogram{100, bin_width}};
+    Step_summary scratch_2T{Running_stats{}, Running_histogram{100, bin_width}};
+    for (Lazy_simulation *run : {&first, &added}) {
+        scratch_2T.add(run->get_valarray_at_step(2 * NUM_TIMESTEPS));
+        scratch_T.add(run->get_valarray_at_step(NUM_TIMESTEPS));
+    }
+    double scratch_time = seconds_since(start);
+
+    std::valarray<double> expected(NUM_SIMS + added_paths);
+    expected[std::slice(0, NUM_SIMS, 1)] = first.get_valarray_at_step(2 * NUM_TIMESTEPS);
+    expected[std::slice(NUM_SIMS, added_paths, 1)] = added.get_valarray_at_step(2 * NUM_TIMESTEPS);
+    const std::valarray<double> &terminal = grown.get_valarray_at_step(2 * NUM_TIMESTEPS);
+    long mismatched = 0;
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        mismatched += terminal[i] != expected[i];
+    }
+
+    std::vector<std::pair<std::string, double>> rows{
+            {"run " + std::to_string(NUM_SIMS) + " paths to T", times[0]},
+            {"extend to 2T", times[1]},
+            {"extend to " + std::to_string(NUM_SIMS + added_paths) + " paths", times[2]},
+            {"same paths from scratch", scratch_time}};
+    std::cout << std::setprecision(6) << '\n';
+    for (const auto &row : rows) {
+        std::cout << "  " << std::left << std::setw(30) << row.first << std::right << row.second << " s" << '\n';
+    }
+    std::cout << '\n';
+
+    bool all_same = true;
+    for (auto step : {std::make_pair(&at_T, &scratch_T), std::make_pair(&at_2T, &scratch_2T)}) {
+        const Running_stats &sink = step.first->stats;
+        const Running_stats &scratch = step.second->stats;
+        bool same = sink.count() == scratch.count() && sink.mean() == scratch.mean() &&
+                    sink.variance() == scratch.variance() && step.first->hist.density() == step.second->hist.density();
+        std::cout << "  " << (step.first == &at_T ? "S_T " : "S_2T") << " sinks: " << sink.count() << " paths, mean "
+                  << sink.mean() << ", variance " << sink.variance() << (same ? ", identical" : ", DIFFERENT")
+                  << " to the from-scratch run" << '\n';
+        all_same = all_same && same;
+    }
+    std::cout << "  S_2T slice: " << mismatched << " of " << expected.size()
+              << " paths differ from the from-scratch run" << "\n\n";
+
+    return mismatched == 0 && all_same ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+/**
+ * \file        sde_heston.cc
+ * \brief       Simulates the Heston stochastic volatility model with the Quadratic-Exponential scheme, keeping only the
+ *              terminal slices. Prints the terminal statistics next to their analytic means and writes the density
+ *              histogram of the terminal prices.
+ *
+ *              Usage: ./sde_heston [num_sims] [num_timesteps] [num_threads]
+ */
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <cmath>
+
+#include "simulation.h"
+#include "heston.h"
+#include "empirical.h"
+#include "scheduler.h"
+
+int main(int argc, char *argv[]) {
+    const long NUM_SIMS{argc > 1 ? std::stol(argv[1]) : 1'000'000};
+    const int NUM_TIMESTEPS{argc > 2 ? std::stoi(argv[2]) : 255};
+    const int NUM_THREADS{argc > 3 ? std::stoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency())};
+    const std::uint64_t SEED{20190324};
+    Parameters params;
+    Heston_parameters heston;
+    std::stringstream outfile;
+
+    Scheduler scheduler{NUM_THREADS};
+    Heston_terminal terminal = simulate_heston_terminal(params, heston, NUM_SIMS, NUM_TIMESTEPS, SEED, scheduler);
+
+    double tau = params.T - params.t0;
+    double mean_price = params.S0 * std::exp(params.mu * tau);
+    double mean_variance = heston.theta + (heston.v0 - heston.theta) * std::exp(-heston.kappa * tau);
+
+    std::cout << std::setprecision(6) << "\nS_T: mean " << terminal.price_stats.mean() << " (analytic " << mean_price
+              << "), variance " << terminal.price_stats.variance() << '\n'
+              << "v_T: mean " << terminal.variance_stats.mean() << " (analytic " << mean_variance << "), min "
+              << terminal.variance_stats.min() << "\n\n";
+
+    outfile << "heston_time_" << params.T << "_sims_" << NUM_SIMS << ".txt";
+    std::map<double, double> hist = create_density_hist(terminal.prices);
+    write_hist_to_file(hist, outfile.str());
+
+    return 0;
+}
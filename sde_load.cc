@@ -0,0 +1,132 @@
+/**
+ * \file        sde_load.cc
+ * \brief       Load generator for sde_serve. Clients on their own threads send queries with random S0, T and sigma,
+ *              one at a time each, and the p50, p90 and p99 round-trip latencies and the throughput are printed.
+ *              The same queries are then answered cold, as a one-shot run would: a pool seeded from
+ *              std::random_device and filled for every query, and the scheme run on one thread. Process start-up is
+ *              not included, so the cold figures are a lower bound.
+ *
+ *              Usage: ./sde_load [socket_path] [num_queries] [num_clients] [num_sims] [num_timesteps] [--shutdown]
+ */
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include <unistd.h>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "lazy.h"
+#include "service.h"
+
+namespace {
+
+/** \brief      Prints the percentiles of a set of latencies in microseconds.
+*/
+void print_latencies(const std::string &name, std::vector<double> micros, double seconds) {
+
+    std::sort(micros.begin(), micros.end());
+    auto at = [&micros](double q) { return micros[static_cast<std::size_t>(q * (micros.size() - 1))]; };
+
+    std::cout << std::setw(6) << std::left << name << std::right << std::fixed << std::setprecision(1)
+              << "  p50 " << std::setw(9) << at(0.5) << " us  p90 " << std::setw(9) << at(0.9) << " us  p99 "
+              << std::setw(9) << at(0.99) << " us  max " << std::setw(9) << micros.back() << " us  "
+              << std::setprecision(1) << micros.size() / seconds << " queries/s" << '\n';
+    std::cout.unsetf(std::ios::fixed);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::vector<std::string> args;
+    bool shutdown{false};
+    for (int i = 1; i < argc; ++i) {
+        std::string arg{argv[i]};
+        if (arg == "--shutdown") {
+            shutdown = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    const std::string SOCKET_PATH{args.size() > 0 ? args[0] : "/tmp/sde_service.sock"};
+    const int NUM_QUERIES{args.size() > 1 ? std::stoi(args[1]) : 1000};
+    const int NUM_CLIENTS{args.size() > 2 ? std::stoi(args[2]) : 4};
+    const long NUM_SIMS{args.size() > 3 ? std::stol(args[3]) : 100'000};
+    const int NUM_TIMESTEPS{args.size() > 4 ? std::stoi(args[4]) : 1};
+
+    std::mt19937_64 engine{20190324};
+    std::uniform_real_distribution<double> unit{0, 1};
+    std::vector<Query> queries(NUM_QUERIES);
+    for (auto &q : queries) {
+        q.params.S0 = 80 + 40 * unit(engine);
+        q.params.T = 0.25 + 1.75 * unit(engine);
+        q.params.sigma = 0.1 + 0.3 * unit(engine);
+        q.num_sims = NUM_SIMS;
+        q.num_timesteps = NUM_TIMESTEPS;
+    }
+
+    // Warm: every client sends its share of the queries over one connection.
+    std::vector<double> warm(NUM_QUERIES);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients;
+    for (int c = 0; c < NUM_CLIENTS; ++c) {
+        clients.emplace_back([&, c] {
+            int fd = connect_to_service(SOCKET_PATH);
+            for (int i = c; i < NUM_QUERIES; i += NUM_CLIENTS) {
+                auto sent = std::chrono::steady_clock::now();
+                std::string reply = request_line(fd, format_query(queries[i]));
+                warm[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sent).count();
+                if (reply.compare(0, 2, "ok") != 0) {
+                    std::cerr << "Error. Query " << i << " failed: " << reply << '\n';
+                    exit(1);
+                }
+            }
+            request_line(fd, "quit");
+            close(fd);
+        });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    std::chrono::duration<double> warm_seconds = std::chrono::steady_clock::now() - start;
+
+    // Cold: a fresh random_device-seeded pool and a single-threaded run per query, on a sample of the queries.
+    std::streambuf *out = std::cout.rdbuf();
+    std::cout.setstate(std::ios_base::badbit);          //< the constructors report to std::cout
+    int num_cold = std::min(NUM_QUERIES, 50);
+    std::vector<double> cold(num_cold);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_cold; ++i) {
+        auto began = std::chrono::steady_clock::now();
+        const Gaussian_RNs pool{static_cast<int>(NUM_SIMS * NUM_TIMESTEPS)};
+        Lazy_simulation sim{Simulation_spec{"exact", queries[i].params, static_cast<int>(NUM_SIMS), NUM_TIMESTEPS,
+                                            pool.cursor(), {NUM_TIMESTEPS}}};
+        Running_stats stats;
+        stats.add(sim.get_valarray_at_step(NUM_TIMESTEPS));
+        cold[i] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - began).count();
+    }
+    std::chrono::duration<double> cold_seconds = std::chrono::steady_clock::now() - start;
+    std::cout.clear();
+    std::cout.rdbuf(out);
+
+    std::cout << '\n' << NUM_QUERIES << " queries of " << NUM_SIMS << " paths x " << NUM_TIMESTEPS << " step(s), "
+              << NUM_CLIENTS << " client(s)\n";
+    print_latencies("warm", warm, warm_seconds.count());
+    print_latencies("cold", cold, cold_seconds.count());
+    std::cout << '\n';
+
+    if (shutdown) {
+        int fd = connect_to_service(SOCKET_PATH);
+        request_line(fd, "shutdown");
+        close(fd);
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+/**
+ * \file        sde_merge.cc
+ * \brief       Merges the shard files written by sde_shard into the result of one run over all the paths. Prints the
+ *              moments and quantiles of the terminal prices and writes their density histogram.
+ *
+ *              Usage: ./sde_merge shard_0_of_4.bin shard_1_of_4.bin ...
+ */
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <map>
+
+#include "empirical.h"
+#include "shard.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: ./sde_merge <shard_file>..." << '\n';
+        return 1;
+    }
+
+    std::vector<Shard_result> shards;
+    for (int i = 1; i < argc; ++i) {
+        shards.push_back(read_shard(argv[i]));
+    }
+    Merged_result merged = merge_shards(shards);
+
+    std::cout << std::setprecision(10) << "\nS_T over " << merged.stats.count() << " paths from " << shards.size()
+              << " shard(s)\n"
+              << "  mean     " << merged.stats.mean() << '\n'
+              << "  variance " << merged.stats.variance() << '\n'
+              << "  min      " << merged.stats.min() << '\n'
+              << "  max      " << merged.stats.max() << '\n';
+    for (double q : {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99}) {
+        std::cout << "  q" << std::setw(4) << std::left << q << std::right << "    " << merged.sketch.quantile(q) << '\n';
+    }
+    std::cout << '\n';
+
+    std::map<double, double> hist = merged.hist.density();
+    write_hist_to_file(hist, "merged_hist.txt");
+
+    return 0;
+}
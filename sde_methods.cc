@@ -10,9 +10,12 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <memory>
 
 #include "myrandom.h"
 #include "simulation.h"
+#include "lazy.h"
 #include "empirical.h"
 
 int main(void) {
@@ -31,54 +34,58 @@ int main(void) {
     /* A unique_ptr is a smart pointer that owns and manages another object through a pointer
        and disposes of that object when the unique_ptr goes out of scope. */
 
+    // Each scheme reads the same Gaussian variates through a cursor of its own. The simulations are built in place
+    // from their specs and only step their paths when the terminal prices are first asked for; only steps 0 and T
+    // are kept.
+    const std::vector<int> terminal{NUM_TIMESTEPS};
+
     // Exact scheme
-    std::unique_ptr<Simulation> EX1 = std::make_unique<Exact_path>(
-            Exact_path{params, NUM_SIMS, NUM_TIMESTEPS, ran_nums});
-    ran_nums.reset_to_start();    // Reset the random number object for next scheme to use the same Gaussian variates.
+    std::unique_ptr<Simulation> EX1 = std::make_unique<Lazy_simulation>(
+            Simulation_spec{"exact", params, NUM_SIMS, NUM_TIMESTEPS, ran_nums.cursor(), terminal});
 
     // Milstein scheme
-    std::unique_ptr<Simulation> M = std::make_unique<Milstein>(Milstein{params, NUM_SIMS, NUM_TIMESTEPS, ran_nums});
-    ran_nums.reset_to_start();    // Reset the random number object for next scheme to use the same Gaussian variates.
+    std::unique_ptr<Simulation> M = std::make_unique<Lazy_simulation>(
+            Simulation_spec{"milstein", params, NUM_SIMS, NUM_TIMESTEPS, ran_nums.cursor(), terminal});
 
     // Euler-Maruyama scheme
-    std::unique_ptr<Simulation> EM = std::make_unique<Euler_Maruyama>(
-            Euler_Maruyama{params, NUM_SIMS, NUM_TIMESTEPS, ran_nums});
+    std::unique_ptr<Simulation> EM = std::make_unique<Lazy_simulation>(
+            Simulation_spec{"euler_maruyama", params, NUM_SIMS, NUM_TIMESTEPS, ran_nums.cursor(), terminal});
 
     // Create histogram of final prices from Exact process
-    outfile << "EX_time_" << params.T << "_timesteps_" << EX1->num_timesteps << ".txt";
-    std::map<double, double> hst1 = create_density_hist(EX1->get_valarray_at_step(EX1->num_timesteps), NUM_BINS);
+    outfile << "EX_time_" << params.T << "_timesteps_" << EX1->num_timesteps() << ".txt";
+    std::map<double, double> hst1 = create_density_hist(EX1->get_valarray_at_step(EX1->num_timesteps()), NUM_BINS);
     write_hist_to_file(hst1, outfile.str());
     outfile.str("");    // Clear stringstream
 
-    outfile << "M_time_" << params.T << "_timesteps_" << M->num_timesteps << ".txt";
-    std::map<double, double> hst2 = create_density_hist(M->get_valarray_at_step(M->num_timesteps), NUM_BINS);
+    outfile << "M_time_" << params.T << "_timesteps_" << M->num_timesteps() << ".txt";
+    std::map<double, double> hst2 = create_density_hist(M->get_valarray_at_step(M->num_timesteps()), NUM_BINS);
     write_hist_to_file(hst2, outfile.str());
     outfile.str("");    // Clear stringstream
 
-    outfile << "EM_time_" << params.T << "_timesteps_" << M->num_timesteps << ".txt";
-    std::map<double, double> hst3 = create_density_hist(EM->get_valarray_at_step(EM->num_timesteps), NUM_BINS);
+    outfile << "EM_time_" << params.T << "_timesteps_" << M->num_timesteps() << ".txt";
+    std::map<double, double> hst3 = create_density_hist(EM->get_valarray_at_step(EM->num_timesteps()), NUM_BINS);
     write_hist_to_file(hst3, outfile.str());
     outfile.str("");    // Clear stringstream
 
     // Calculate (central) moments of empirical distributions
-    std::cout << "\nExpected value Exact: " << expected_value(EX1->get_valarray_at_step(EX1->num_timesteps));
-    std::cout << "\nVariance Exact: " << variance(EX1->get_valarray_at_step(EX1->num_timesteps));
+    std::cout << "\nExpected value Exact: " << expected_value(EX1->get_valarray_at_step(EX1->num_timesteps()));
+    std::cout << "\nVariance Exact: " << variance(EX1->get_valarray_at_step(EX1->num_timesteps()));
     std::cout << "\n\n";
 
-    std::cout << "\nExpected value Milstein: " << expected_value(M->get_valarray_at_step(M->num_timesteps));
-    std::cout << "\nVariance Exact Milstein: " << variance(M->get_valarray_at_step(M->num_timesteps));
+    std::cout << "\nExpected value Milstein: " << expected_value(M->get_valarray_at_step(M->num_timesteps()));
+    std::cout << "\nVariance Exact Milstein: " << variance(M->get_valarray_at_step(M->num_timesteps()));
     std::cout << "\n\n";
 
-    std::cout << "\nExpected value Euler-Maruyama: " << expected_value(EM->get_valarray_at_step(EM->num_timesteps));
-    std::cout << "\nVariance Exact Euler-Maruyama: " << variance(EM->get_valarray_at_step(EM->num_timesteps));
+    std::cout << "\nExpected value Euler-Maruyama: " << expected_value(EM->get_valarray_at_step(EM->num_timesteps()));
+    std::cout << "\nVariance Exact Euler-Maruyama: " << variance(EM->get_valarray_at_step(EM->num_timesteps()));
     std::cout << "\n\n";
 
     // Create valarray of log returns at time step 0 for Exact scheme.
     std::valarray<double> log_rets1{
-            std::log(EX1->get_valarray_at_step(EX1->num_timesteps) / EX1->get_valarray_at_step(0))};
+            std::log(EX1->get_valarray_at_step(EX1->num_timesteps()) / EX1->get_valarray_at_step(0))};
 
     // Create a histogram of log returns for Exact scheme.
-    outfile << "EX_time_" << params.T << "_log_rets_at_timestep" << EX1->num_timesteps << ".txt";
+    outfile << "EX_time_" << params.T << "_log_rets_at_timestep" << EX1->num_timesteps() << ".txt";
     std::map<double, double> hst1_1 = create_density_hist(log_rets1, NUM_BINS);
     write_hist_to_file(hst1_1, outfile.str());
     outfile.str("");    // Clear stringstream
@@ -0,0 +1,48 @@
+/**
+ * \file        sde_pipeline.cc
+ * \brief       Runs the exact scheme through the generate, step, reduce and write stages, first one chunk at a time and
+ *              then with the stages overlapped on their own threads. Prints the busy time of each stage and the wall
+ *              time of both runs, writes the terminal prices and their density histogram.
+ *
+ *              Usage: ./sde_pipeline [num_sims] [num_timesteps] [blocks_per_chunk] [queue_depth] [num_threads]
+ *              The step stage spreads the blocks of each chunk over num_threads workers.
+ */
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <map>
+#include <thread>
+
+#include "simulation.h"
+#include "empirical.h"
+#include "pipeline.h"
+#include "scheduler.h"
+
+int main(int argc, char *argv[]) {
+    const long NUM_SIMS{argc > 1 ? std::stol(argv[1]) : 1'000'000};
+    const int NUM_TIMESTEPS{argc > 2 ? std::stoi(argv[2]) : 255};
+    const int BLOCKS_PER_CHUNK{argc > 3 ? std::stoi(argv[3]) : 4};
+    const int QUEUE_DEPTH{argc > 4 ? std::stoi(argv[4]) : 2};
+    const int NUM_THREADS{argc > 5 ? std::stoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency())};
+    const std::uint64_t SEED{20190324};
+    Parameters params;
+    std::stringstream outfile;
+    Scheduler scheduler{NUM_THREADS};
+
+    outfile << "pipeline_prices_sims_" << NUM_SIMS << ".txt";
+    Pipeline_spec spec{"exact", params, NUM_SIMS, NUM_TIMESTEPS, SEED, outfile.str(), params.S0 / 100,
+                       BLOCKS_PER_CHUNK, QUEUE_DEPTH};
+
+    std::cout << "\nSequential stages\n";
+    print_pipeline_result(run_pipeline(spec, scheduler, false), std::cout);
+
+    std::cout << "\nOverlapped stages\n";
+    Pipeline_result result = run_pipeline(spec, scheduler, true);
+    print_pipeline_result(result, std::cout);
+    std::cout << '\n';
+
+    std::map<double, double> hist = result.hist.density();
+    write_hist_to_file(hist, "pipeline_hist.txt");
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+/**
+ * \file        sde_plan.cc
+ * \brief       Runs the exact GBM scheme through the analytic shortcut planner for terminal, monitored or full path
+ *              output, and prints each plan, its run time and the empirical moments next to the analytic ones.
+ *
+ *              Usage: ./sde_plan [num_sims] [num_timesteps] [num_threads] [full_path_mb]
+ *              The monitoring schedule is every 21st step (monthly for 252 daily steps). The full path plan stores every
+ *              step, so it runs on as many of the paths as fit in full_path_mb (default 256) of slices.
+ */
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+#include "simulation.h"
+#include "planner.h"
+#include "scheduler.h"
+
+int main(int argc, char *argv[]) {
+    const long NUM_SIMS{argc > 1 ? std::stol(argv[1]) : 1'000'000};
+    const int NUM_TIMESTEPS{argc > 2 ? std::stoi(argv[2]) : 252};
+    const int NUM_THREADS{argc > 3 ? std::stoi(argv[3]) : static_cast<int>(std::thread::hardware_concurrency())};
+    const std::size_t FULL_PATH_BYTES{(argc > 4 ? std::stoul(argv[4]) : 256) << 20};
+    const std::uint64_t SEED{20190324};
+    Parameters params;
+
+    std::vector<int> monthly;
+    for (int k = 21; k <= NUM_TIMESTEPS; k += 21) {
+        monthly.push_back(k);
+    }
+
+    Scheduler scheduler{NUM_THREADS};
+    std::vector<Exact_plan> plans{plan_exact(params, NUM_TIMESTEPS, Output_need::terminal),
+                                  plan_exact(params, NUM_TIMESTEPS, Output_need::schedule, monthly),
+                                  plan_exact(params, NUM_TIMESTEPS, Output_need::full_path)};
+
+    for (const auto &plan : plans) {
+        long max_sims = static_cast<long>(FULL_PATH_BYTES / (plan.stored_steps.size() * sizeof(double)));
+        long num_sims = std::max(1L, std::min(NUM_SIMS, max_sims));
+
+        auto start = std::chrono::steady_clock::now();
+        Planned_run run = run_exact_plan(params, num_sims, plan, SEED, scheduler);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << '\n';
+        print_planned_run(run, std::cout);
+        if (num_sims < NUM_SIMS) {
+            std::cout << "  paths    " << num_sims << " of " << NUM_SIMS << ", to keep the stored slices within "
+                      << (FULL_PATH_BYTES >> 20) << " MB" << '\n';
+        }
+        std::cout << "  time     " << elapsed.count() << " s" << '\n';
+    }
+    std::cout << '\n';
+
+    return 0;
+}
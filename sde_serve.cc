@@ -0,0 +1,27 @@
+/**
+ * \file        sde_serve.cc
+ * \brief       Runs the simulation service on a Unix socket with its worker threads and variate pool kept warm,
+ *              answering one query line (scheme S0 T sigma mu num_sims num_timesteps) with the terminal statistics.
+ *              Runs until a client sends "shutdown".
+ *
+ *              Usage: ./sde_serve [socket_path] [num_threads] [pool_variates] [max_path_steps]
+ *              Queries of more than max_path_steps num_sims x num_timesteps (default 1e9) are refused.
+ */
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "service.h"
+
+int main(int argc, char *argv[]) {
+    const std::string SOCKET_PATH{argc > 1 ? argv[1] : "/tmp/sde_service.sock"};
+    const int NUM_THREADS{argc > 2 ? std::stoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency())};
+    const int POOL_VARIATES{argc > 3 ? std::stoi(argv[3]) : 1 << 24};
+    const double MAX_PATH_STEPS{argc > 4 ? std::stod(argv[4]) : 1e9};
+    const std::uint64_t SEED{20190324};
+
+    Simulation_service service{NUM_THREADS, POOL_VARIATES, SEED, MAX_PATH_STEPS};
+    service.serve(SOCKET_PATH);
+
+    return 0;
+}
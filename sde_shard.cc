@@ -0,0 +1,42 @@
+/**
+ * \file        sde_shard.cc
+ * \brief       Simulates one shard of a terminal-price run of the exact scheme and writes its moments, histogram and
+ *              quantile sketch to shard_<shard>_of_<num_shards>.bin, to be combined by sde_merge. Shards can run as
+ *              separate processes, on one machine or several, in any order.
+ *
+ *              Usage: ./sde_shard <shard> <num_shards> [num_sims] [num_timesteps] [num_threads]
+ */
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "simulation.h"
+#include "scheduler.h"
+#include "shard.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: ./sde_shard <shard> <num_shards> [num_sims] [num_timesteps] [num_threads]" << '\n';
+        return 1;
+    }
+
+    const int SHARD{std::stoi(argv[1])};
+    const int NUM_SHARDS{std::stoi(argv[2])};
+    const long NUM_SIMS{argc > 3 ? std::stol(argv[3]) : 1'000'000};
+    const int NUM_TIMESTEPS{argc > 4 ? std::stoi(argv[4]) : 255};
+    const int NUM_THREADS{argc > 5 ? std::stoi(argv[5]) : static_cast<int>(std::thread::hardware_concurrency())};
+    const std::uint64_t SEED{20190324};
+    Parameters params;
+    std::stringstream outfile;
+
+    Shard_spec spec{"exact", params, NUM_SIMS, NUM_TIMESTEPS, SEED, SHARD, NUM_SHARDS, params.S0 / 100};
+
+    Scheduler scheduler{NUM_THREADS};
+    Shard_result result = run_shard(spec, scheduler);
+
+    outfile << "shard_" << SHARD << "_of_" << NUM_SHARDS << ".bin";
+    write_shard(result, outfile.str());
+
+    return 0;
+}
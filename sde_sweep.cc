@@ -0,0 +1,56 @@
+/**
+ * \file        sde_sweep.cc
+ * \brief       Runs a batch of GBM scenarios, read from a scenario file, concurrently on a work-stealing scheduler and writes
+ *              the terminal statistics and histograms of each.
+ *
+ *              Usage: ./sde_sweep scenario_file [num_threads] [num_bins] [cache_dir]
+ *              See example_scenarios.dat for the file format. With a cache directory, scenarios run before are read
+ *              from the result cache there instead of being simulated again.
+ */
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <memory>
+
+#include "empirical.h"
+#include "sweep.h"
+#include "scheduler.h"
+#include "result_cache.h"
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " scenario_file [num_threads] [num_bins] [cache_dir]" << '\n';
+        return 1;
+    }
+
+    const int NUM_THREADS{argc > 2 ? std::stoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency())};
+    const int NUM_BINS{argc > 3 ? std::stoi(argv[3]) : 10};
+    std::unique_ptr<Result_cache> cache{argc > 4 ? std::make_unique<Result_cache>(argv[4]) : nullptr};
+    std::stringstream outfile;
+
+    std::vector<Scenario> scenarios = read_scenarios(argv[1]);
+    Scheduler scheduler{NUM_THREADS};
+    std::cout << "Running " << scenarios.size() << " scenarios on " << scheduler.num_workers() << " threads." << '\n';
+
+    std::vector<Scenario_result> results = run_sweep(scenarios, scheduler, NUM_BINS, std::size_t{1} << 30, cache.get());
+
+    if (cache) {
+        Cache_counts counts = cache->counts();
+        std::cout << "Result cache: " << counts.memory_hits + counts.disk_hits << " hits, " << counts.misses
+                  << " misses." << '\n';
+    }
+
+    for (auto &r : results) {
+        outfile << r.scenario.name << "_" << r.scenario.scheme << "_time_" << r.scenario.params.T << "_timesteps_"
+                << r.scenario.num_timesteps << ".txt";
+        write_hist_to_file(r.hist, outfile.str());
+        outfile.str("");    // Clear stringstream
+    }
+
+    write_sweep_to_file(results, "sweep_results.txt");
+
+    return 0;
+}
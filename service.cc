@@ -0,0 +1,340 @@
+#include <vector>
+#include <valarray>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+#include "service.h"
+#include "instrument.h"
+
+namespace {
+
+/** \brief      The address of a Unix socket, exiting if the path is too long for it.
+*/
+sockaddr_un socket_address(const std::string &socket_path) {
+
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error. Socket path " << socket_path << " is too long." << '\n';
+        exit(1);
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    return addr;
+}
+
+/** \brief      Writes all of line to fd. Returns false if the peer has gone.
+*/
+bool write_all(int fd, const std::string &line) {
+
+    std::size_t done = 0;
+    while (done < line.size()) {
+        ssize_t n = send(fd, line.data() + done, line.size() - done, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+} // namespace
+
+/** \brief 		Reads a query line, scheme S0 T sigma mu num_sims num_timesteps.
+*   \param      max_path_steps - The most num_sims x num_timesteps a query may ask for.
+*   \return		bool . Whether the line is a valid query, error says why when it is not.
+*
+*/
+bool parse_query(const std::string &line, Query &query, std::string &error, double max_path_steps) {
+
+    std::istringstream fields(line);
+    if (!(fields >> query.scheme >> query.params.S0 >> query.params.T >> query.params.sigma >> query.params.mu >>
+          query.num_sims >> query.num_timesteps)) {
+        error = "expected: scheme S0 T sigma mu num_sims num_timesteps";
+        return false;
+    }
+    if (query.scheme != "exact" && query.scheme != "milstein" && query.scheme != "euler_maruyama") {
+        error = "unknown scheme " + query.scheme;
+        return false;
+    }
+    if (query.num_sims < 1 || query.num_timesteps < 1 || query.params.T <= query.params.t0) {
+        error = "num_sims and num_timesteps must be positive and T after t0";
+        return false;
+    }
+    if (!(query.params.sigma >= 0)) {
+        error = "sigma must not be negative";
+        return false;
+    }
+    if (static_cast<double>(query.num_sims) * query.num_timesteps > max_path_steps) {
+        std::ostringstream limit;
+        limit << "num_sims x num_timesteps must not exceed " << max_path_steps;
+        error = limit.str();
+        return false;
+    }
+    return true;
+}
+
+/** \brief      Writes a query as the line parse_query() reads.
+*/
+std::string format_query(const Query &query) {
+
+    std::ostringstream line;
+    line << std::setprecision(17) << query.scheme << ' ' << query.params.S0 << ' ' << query.params.T << ' '
+         << query.params.sigma << ' ' << query.params.mu << ' ' << query.num_sims << ' ' << query.num_timesteps;
+    return line.str();
+}
+
+/** \brief      Writes a result as its reply line.
+*/
+std::string format_result(const Query_result &result) {
+
+    std::ostringstream line;
+    line << std::setprecision(17) << "ok " << result.stats.mean() << ' ' << result.stats.variance() << ' '
+         << result.stats.min() << ' ' << result.stats.max() << ' ' << std::setprecision(6) << result.micros;
+    return line.str();
+}
+
+/** \brief 		Starts the workers and draws the variate pool once.
+*   \param 		num_workers - The number of worker threads.
+*   \param      pool_variates - The size of the warm pool.
+*   \param      seed - The seed of the pool and of the Block_streams of larger queries.
+*   \param      max_path_steps - Queries of more num_sims x num_timesteps are refused.
+*
+*/
+Simulation_service::Simulation_service(int num_workers, int pool_variates, std::uint64_t seed, double max_path_steps)
+        : scheduler_{num_workers}, pool_{pool_variates, seed}, seed_{seed}, max_path_steps_{max_path_steps},
+          streams_{scheduler_} {
+    std::cout << "Simulation_service constructor constructing.\n";
+}
+
+/** \brief      Stops serving and waits for the connection threads to finish.
+*/
+Simulation_service::~Simulation_service() {
+    stop();
+    std::unique_lock<std::mutex> lock{clients_mutex_};
+    clients_done_.wait(lock, [this] { return client_fds_.empty(); });
+    std::cout << "Simulation_service destructor" << std::endl;
+}
+
+/** \brief 		Runs one query on the scheduler. Safe to call from several threads at once.
+*   \param 		query - The scheme, parameters, paths and steps.
+*   \return		Query_result . The statistics of the terminal prices and the time taken.
+*
+*/
+Query_result Simulation_service::answer(const Query &query) {
+
+    SDE_PHASE("service.answer", query.num_sims * query.num_timesteps);
+
+    auto start = std::chrono::steady_clock::now();
+    Step_function step = scheme_step(query.scheme);
+    Step_table table{query.params, query.num_timesteps};
+    double delta_t = (query.params.T - query.params.t0) / query.num_timesteps;
+    const long N = query.num_sims;
+    const bool from_pool = static_cast<double>(N) * query.num_timesteps <= pool_.size();
+
+    long num_blocks = (N + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+    std::vector<Running_stats> block_stats(num_blocks);
+
+    scheduler_.parallel_range(0, num_blocks, 1, [&](long first_block, long blocks) {
+        Block_stream &stream = streams_.local();
+        for (long b = first_block; b < first_block + blocks; ++b) {
+            long first = b * Block_stream::paths_per_block;
+            int n = static_cast<int>(std::min<long>(Block_stream::paths_per_block, N - first));
+            std::valarray<double> prices(query.params.S0, n);
+            std::valarray<double> rans(n);
+
+            if (!from_pool) {
+                stream.seek(seed_, b);
+            }
+            for (int k = 0; k < query.num_timesteps; ++k) {
+                if (from_pool) {
+                    const double *z = pool_.data() + k * N + first;
+                    std::copy(z, z + n, std::begin(rans));
+                } else {
+                    stream.fill(&rans[0], n);
+                }
+                step(prices, rans, table[k], delta_t);
+            }
+            block_stats[b].add(prices);
+        }
+    });
+
+    Query_result result{Running_stats{}, 0};
+    for (const auto &st : block_stats) {
+        result.stats.merge(st);
+    }
+    result.micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+/** \brief 		Listens on a Unix socket and serves every connection on its own thread until a
+*				client sends "shutdown" or stop() is called. A stale socket file is replaced. When
+*				accept() runs out of descriptors or memory it logs and retries after a pause, and on
+*				any other failure it stops serving.
+*   \param 		socket_path - The path of the socket.
+*
+*/
+void Simulation_service::serve(const std::string &socket_path) {
+
+    sockaddr_un addr = socket_address(socket_path);
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd, 64) != 0) {
+        std::cerr << "Error listening on " << socket_path << ": " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    listen_fd_ = listen_fd;         //< before the loop reads stopping_: a stop() shuts it down or is seen
+
+    std::cout << "Serving on " << socket_path << " with " << scheduler_.num_workers() << " worker(s) and "
+              << pool_.size() << " pooled variates" << std::endl;
+
+    while (!stopping_) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            int err = errno;
+            if (stopping_ || err == EINTR || err == ECONNABORTED) {
+                continue;                               //< woken by stop(), or interrupted
+            }
+            std::cerr << "Error accepting on " << socket_path << ": " << std::strerror(err) << '\n';
+            if (err != EMFILE && err != ENFILE && err != ENOBUFS && err != ENOMEM) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));   //< until connections close
+            continue;
+        }
+        std::lock_guard<std::mutex> lock{clients_mutex_};
+        client_fds_.push_back(fd);
+        std::thread([this, fd] { handle(fd); }).detach();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{clients_mutex_};
+        listen_fd_ = -1;
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+}
+
+/** \brief      Stops serve() and shuts every open connection down.
+*/
+void Simulation_service::stop() {
+
+    stopping_ = true;
+    std::lock_guard<std::mutex> lock{clients_mutex_};
+    int listen_fd = listen_fd_;
+    if (listen_fd >= 0) {
+        shutdown(listen_fd, SHUT_RDWR);                 //< wakes the accept() of serve()
+    }
+    for (int fd : client_fds_) {
+        shutdown(fd, SHUT_RDWR);
+    }
+}
+
+/** \brief      Answers the query lines of one connection until it closes or sends "quit". A line
+*               longer than max_line_bytes is answered with an error and closes the connection.
+*/
+void Simulation_service::handle(int fd) {
+
+    std::string pending;
+    char buffer[4096];
+
+    while (!stopping_) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            break;
+        }
+        pending.append(buffer, n);
+
+        std::size_t end;
+        while ((end = pending.find('\n')) != std::string::npos && end <= max_line_bytes) {
+            std::string line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+
+            if (line == "quit") {
+                n = 0;
+                break;
+            }
+            if (line == "shutdown") {
+                write_all(fd, "ok shutting down\n");
+                stop();
+                n = 0;
+                break;
+            }
+
+            Query query;
+            std::string error;
+            std::string reply = parse_query(line, query, error, max_path_steps_) ? format_result(answer(query)) : "error " + error;
+            if (!write_all(fd, reply + '\n')) {
+                n = 0;
+                break;
+            }
+        }
+        if (n == 0) {
+            break;
+        }
+        if (std::min(pending.find('\n'), pending.size()) > max_line_bytes) {
+            write_all(fd, "error query lines are limited to " + std::to_string(max_line_bytes) + " bytes\n");
+            shutdown(fd, SHUT_WR);
+            while (recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+            }                                           //< unread input would reset the connection over the reply
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock{clients_mutex_};
+    client_fds_.erase(std::find(client_fds_.begin(), client_fds_.end(), fd));
+    close(fd);
+    clients_done_.notify_all();
+}
+
+/** \brief      Connects to a service, exiting when there is none at socket_path.
+*   \return     int . The connected socket.
+*/
+int connect_to_service(const std::string &socket_path) {
+
+    sockaddr_un addr = socket_address(socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error connecting to " << socket_path << ": " << std::strerror(errno) << '\n';
+        exit(1);
+    }
+    return fd;
+}
+
+/** \brief      Sends one line to a service and waits for its one-line reply.
+*   \return     std::string . The reply without its newline, empty if the connection closed.
+*/
+std::string request_line(int fd, const std::string &line) {
+
+    if (!write_all(fd, line + '\n')) {
+        return "";
+    }
+
+    std::string reply;
+    char buffer[256];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {      //< one reply per line, so never past it
+        reply.append(buffer, n);
+        if (reply.back() == '\n') {
+            reply.pop_back();
+            return reply;
+        }
+    }
+    return "";
+}
@@ -0,0 +1,97 @@
+#ifndef SERVICE_H_RVYDKCPA
+#define SERVICE_H_RVYDKCPA
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <condition_variable>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+
+/**
+ * \brief One simulation request: a scheme, the GBM parameters, and the paths and steps to run. Sent to the
+ *        service as one line
+ *
+ *  scheme S0 T sigma mu num_sims num_timesteps
+ */
+struct Query {
+    std::string scheme = "exact";
+    Parameters params;
+    long num_sims;
+    int num_timesteps;
+};
+
+/**
+ * \brief The terminal statistics of a query and the time the service took to compute them. Sent back as one
+ *        line
+ *
+ *  ok mean variance min max micros
+ *
+ * or "error <message>".
+ */
+struct Query_result {
+    Running_stats stats;
+    double micros;
+};
+
+bool parse_query(const std::string &line, Query &query, std::string &error, double max_path_steps);
+
+std::string format_query(const Query &query);
+
+std::string format_result(const Query_result &result);
+
+/**
+ * \brief A long-running simulation service on a Unix socket, with its worker threads and variate pool warm.
+ *
+ * The pool is drawn once at start-up. A query of N paths and ts steps whose N x ts variates fit in it reads them
+ * from the pool, step k of path i using pool[k * N + i] as sde_sweep does, so it pays neither the seeding of a
+ * Mersenne Twister nor the fill. Larger queries draw from Block_streams seeded by the service's seed. Either
+ * way the paths run in Block_stream blocks on the service's scheduler, their statistics are merged in block
+ * order, and a query always gets the same answer. Queries reuse the same variates, so the answers of nearby
+ * parameters are smooth in them (common random numbers).
+ *
+ * A query asking for more than max_path_steps paths x steps, or with a negative sigma, gets an error reply
+ * instead of an answer. Each connection is served by its own thread, one query line at a time, and any number
+ * of connections share the scheduler. A "quit" line closes the connection and a "shutdown" line stops the service.
+ * A line longer than max_line_bytes gets an error reply and its connection is closed.
+ */
+class Simulation_service {
+public:
+    static constexpr std::size_t max_line_bytes = 4096;    //!< The longest query line read
+
+    Simulation_service(int num_workers, int pool_variates, std::uint64_t seed, double max_path_steps = 1e9);
+
+    ~Simulation_service();
+
+    Query_result answer(const Query &query);
+
+    void serve(const std::string &socket_path);
+
+    void stop();
+
+private:
+    void handle(int fd);
+
+    Scheduler scheduler_;
+    const Gaussian_RNs pool_;
+    std::uint64_t seed_;
+    double max_path_steps_;                     //!< The largest num_sims x num_timesteps served
+    Per_worker<Block_stream> streams_;
+    std::atomic<int> listen_fd_{-1};            //!< Set once serve() listens, shut down by stop()
+    std::atomic<bool> stopping_{false};
+    std::mutex clients_mutex_;
+    std::condition_variable clients_done_;
+    std::vector<int> client_fds_;               //!< Open connections, shut down by stop()
+};
+
+int connect_to_service(const std::string &socket_path);
+
+std::string request_line(int fd, const std::string &line);
+
+#endif /* end of include guard: SERVICE_H_RVYDKCPA */
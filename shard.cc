@@ -0,0 +1,237 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+#include "shard.h"
+#include "instrument.h"
+
+namespace {
+
+const char magic[8] = {'S', 'D', 'E', 'S', 'H', 'R', 'D', '1'};
+
+/**
+ * \brief The fixed-size part of a shard file. It is followed by the key, the block statistics, the
+ *        histogram and the sketch.
+ */
+struct Shard_header {
+    char magic[8];
+    std::int64_t num_sims;
+    std::uint64_t seed;
+    std::int64_t paths_per_block;
+    std::int64_t num_timesteps;
+    std::int64_t num_shards;
+    std::int64_t first_block;
+    std::int64_t num_blocks;
+    std::uint64_t key_size;
+};
+
+/** \brief      The scheme and the parameters a shard ran with, as text, term structure and local
+*               volatility surface included, so shards of different models never merge.
+*/
+std::string shard_key(const Shard_spec &spec) {
+
+    std::stringstream ss;
+    ss.precision(17);
+    ss << spec.scheme << ' ' << parameters_key(spec.params) << ' ' << spec.bin_width << ' ' << spec.sketch_alpha;
+    return ss.str();
+}
+
+} // namespace
+
+/** \brief 		Simulates the blocks of one shard on the scheduler's workers. Each block steps its
+*				paths to T with the scheme, from the variates of its own seeked Block_stream, and
+*				only the terminal prices are summarised: their moments per block, and their
+*				histogram and sketch per worker, merged once every block is done.
+*   \param 		spec - The run and which shard of it to simulate.
+*   \param      scheduler - The work-stealing scheduler to run on.
+*   \return		Shard_result . The mergeable state of the shard.
+*
+*/
+Shard_result run_shard(const Shard_spec &spec, Scheduler &scheduler) {
+
+    if (spec.num_shards < 1 || spec.shard < 0 || spec.shard >= spec.num_shards) {
+        std::cerr << "Error. Shard " << spec.shard << " does not exist in " << spec.num_shards << " shards." << '\n';
+        exit(1);
+    }
+    if (spec.bin_width <= 0) {
+        std::cerr << "Error. Sharded runs need a positive bin width." << '\n';
+        exit(1);
+    }
+
+    long num_blocks = (spec.num_sims + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+    long first_block = num_blocks * spec.shard / spec.num_shards;
+    long last_block = num_blocks * (spec.shard + 1) / spec.num_shards;
+
+    SDE_PHASE("shard.run", std::min(spec.num_sims, last_block * Block_stream::paths_per_block)
+                           - first_block * Block_stream::paths_per_block);
+
+    Step_function step = scheme_step(spec.scheme);
+    Step_table table{spec.params, spec.num_timesteps};
+    double delta_t = (spec.params.T - spec.params.t0) / spec.num_timesteps;
+
+    Shard_result result{shard_key(spec), spec.num_sims, spec.num_timesteps, spec.seed, spec.num_shards, first_block,
+                        std::vector<Running_stats>(last_block - first_block),
+                        Running_histogram{100, spec.bin_width}, Quantile_sketch{spec.sketch_alpha}};
+
+    int num_workers = scheduler.num_workers();
+    Per_worker<Block_stream> streams(scheduler);
+    std::vector<Running_histogram> hists(num_workers, Running_histogram{100, spec.bin_width});
+    std::vector<Quantile_sketch> sketches(num_workers, Quantile_sketch{spec.sketch_alpha});
+
+    scheduler.parallel_range(first_block, last_block - first_block, 1, [&](long first, long blocks) {
+        int w = scheduler.worker_index();
+        for (long b = first; b < first + blocks; ++b) {
+            int n = static_cast<int>(std::min<long>(Block_stream::paths_per_block,
+                                                    spec.num_sims - b * Block_stream::paths_per_block));
+            std::valarray<double> prices(spec.params.S0, n);
+            std::valarray<double> rans(n);
+
+            Block_stream &stream = streams.local();
+            stream.seek(spec.seed, b);
+            for (int k = 0; k < spec.num_timesteps; ++k) {
+                stream.fill(&rans[0], n);
+                step(prices, rans, table[k], delta_t);
+            }
+
+            result.block_stats[b - first_block].add(prices);
+            hists[w].add(prices);
+            sketches[w].add(prices);
+        }
+    });
+
+    for (int w = 0; w < num_workers; ++w) {
+        result.hist.merge(hists[w]);
+        result.sketch.merge(sketches[w]);
+    }
+    return result;
+}
+
+/** \brief      Writes a shard's state to a binary file.
+*/
+void write_shard(const Shard_result &result, std::string filename) {
+
+    std::cout << "Writing shard to file: " << filename << '\n';
+
+    Shard_header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.num_sims = result.num_sims;
+    header.seed = result.seed;
+    header.paths_per_block = Block_stream::paths_per_block;
+    header.num_timesteps = result.num_timesteps;
+    header.num_shards = result.num_shards;
+    header.first_block = result.first_block;
+    header.num_blocks = result.block_stats.size();
+    header.key_size = result.key.size();
+
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(result.key.data(), result.key.size());
+    out.write(reinterpret_cast<const char *>(result.block_stats.data()),
+              result.block_stats.size() * sizeof(Running_stats));
+    result.hist.write(out);
+    result.sketch.write(out);
+    out.flush();
+
+    if (!out) {
+        std::cerr << "Error writing shard " << filename << '\n';
+        exit(1);
+    }
+}
+
+/** \brief      Reads a shard file written by write_shard().
+*/
+Shard_result read_shard(std::string filename) {
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error opening shard " << filename << '\n';
+        exit(1);
+    }
+
+    Shard_header header;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+        header.paths_per_block != Block_stream::paths_per_block) {
+        std::cerr << "Error. " << filename << " is not a shard file of this build." << '\n';
+        exit(1);
+    }
+
+    Shard_result result{std::string(header.key_size, '\0'), header.num_sims,
+                        static_cast<int>(header.num_timesteps), header.seed, static_cast<int>(header.num_shards),
+                        header.first_block, std::vector<Running_stats>(header.num_blocks), Running_histogram{},
+                        Quantile_sketch{}};
+    in.read(&result.key[0], header.key_size);
+    in.read(reinterpret_cast<char *>(result.block_stats.data()), header.num_blocks * sizeof(Running_stats));
+    result.hist.read(in);
+    result.sketch.read(in);
+
+    if (!in) {
+        std::cerr << "Error. Shard " << filename << " is truncated." << '\n';
+        exit(1);
+    }
+    return result;
+}
+
+/** \brief 		Merges the shards of one run. They must agree on the run (key, N, seed, steps and
+*				number of shards) and cover its blocks exactly once, in any order. The block
+*				moments are merged in block order, so the result equals that of a single shard
+*				run over all N paths.
+*   \param 		shards - The shards, one per file.
+*   \return		Merged_result . The moments, histogram and sketch of the whole run.
+*
+*/
+Merged_result merge_shards(std::vector<Shard_result> shards) {
+
+    SDE_PHASE("shard.merge");
+
+    if (shards.empty()) {
+        std::cerr << "Error. No shards to merge." << '\n';
+        exit(1);
+    }
+
+    std::sort(shards.begin(), shards.end(),
+              [](const Shard_result &a, const Shard_result &b) { return a.first_block < b.first_block; });
+
+    const Shard_result &run = shards.front();
+    long num_blocks = (run.num_sims + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+    long next_block = 0;
+    Merged_result merged;
+
+    for (const Shard_result &s : shards) {
+        if (s.key != run.key || s.num_sims != run.num_sims || s.seed != run.seed ||
+            s.num_timesteps != run.num_timesteps || s.num_shards != run.num_shards) {
+            std::cerr << "Error. The shards come from different runs." << '\n';
+            exit(1);
+        }
+        if (s.first_block > next_block) {
+            std::cerr << "Error. Blocks " << next_block << " to " << s.first_block - 1 << " are missing." << '\n';
+            exit(1);
+        }
+        if (s.first_block < next_block) {
+            std::cerr << "Error. Block " << s.first_block << " is in more than one shard." << '\n';
+            exit(1);
+        }
+
+        for (const Running_stats &st : s.block_stats) {
+            merged.stats.merge(st);
+        }
+        merged.hist.merge(s.hist);
+        merged.sketch.merge(s.sketch);
+        next_block += s.block_stats.size();
+    }
+
+    if (next_block != num_blocks) {
+        std::cerr << "Error. Blocks " << next_block << " to " << num_blocks - 1 << " are missing." << '\n';
+        exit(1);
+    }
+    return merged;
+}
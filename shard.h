@@ -0,0 +1,69 @@
+#ifndef SHARD_H_TQZBWLEC
+#define SHARD_H_TQZBWLEC
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "simulation.h"
+#include "empirical.h"
+#include "scheduler.h"
+
+/**
+ * \brief One process's share of a terminal-price run split across processes.
+ *
+ * The N paths are cut into Block_stream blocks as in parallel_blocks(), and shard k of num_shards runs the
+ * contiguous blocks [k * B / num_shards, (k + 1) * B / num_shards) of the B blocks. Each block seeks its own
+ * stream to (seed, block), so the shards need no coordination and together draw exactly the variates of one
+ * run over all N paths. Every shard must use the same bin width for its histogram to merge.
+ */
+struct Shard_spec {
+    std::string scheme = "exact";
+    Parameters params;              //!< Constant mu and sigma only, the term structure is not recorded
+    long num_sims;
+    int num_timesteps;
+    std::uint64_t seed;
+    int shard;
+    int num_shards;
+    double bin_width;
+    double sketch_alpha = 0.005;
+};
+
+/**
+ * \brief The mergeable state of a shard: the moments of each of its blocks, and the histogram and quantile
+ *        sketch of all its terminal prices.
+ *
+ * Moments are kept per block rather than per shard because floating point merges are not associative: the
+ * merge tool combines every block in block order, exactly as a single run does, and so reproduces its mean
+ * and variance bit for bit. Histogram and sketch counts are integers and merge exactly in any order.
+ */
+struct Shard_result {
+    std::string key;                            //!< Scheme and parameters, checked by merge_shards()
+    long num_sims;
+    int num_timesteps;
+    std::uint64_t seed;
+    int num_shards;
+    long first_block;
+    std::vector<Running_stats> block_stats;     //!< One per block from first_block on
+    Running_histogram hist;
+    Quantile_sketch sketch;
+};
+
+/**
+ * \brief The merge of every shard of a run.
+ */
+struct Merged_result {
+    Running_stats stats;
+    Running_histogram hist;
+    Quantile_sketch sketch;
+};
+
+Shard_result run_shard(const Shard_spec &spec, Scheduler &scheduler);
+
+void write_shard(const Shard_result &result, std::string filename);
+
+Shard_result read_shard(std::string filename);
+
+Merged_result merge_shards(std::vector<Shard_result> shards);
+
+#endif /* end of include guard: SHARD_H_TQZBWLEC */
@@ -2,9 +2,76 @@
 #include <sstream>
 #include <iostream>
 #include <cmath>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <functional>
 
 #include "myrandom.h"
 #include "simulation.h"
+#include "placement.h"
+#include "scheduler.h"
+#include "instrument.h"
+
+namespace {
+
+/** \brief      Integral over [a, b] of a piecewise constant curve whose piece i ends at ends[i]
+*               (the last piece extends forever), or of its square.
+*/
+double integrate_piecewise(const std::vector<double> &ends, const std::vector<double> &vals, double a, double b,
+                           bool squared) {
+
+    double total = 0;
+    double start = -std::numeric_limits<double>::infinity();
+
+    for (std::size_t i = 0; i < vals.size(); ++i) {
+        double end = i + 1 == vals.size() ? std::numeric_limits<double>::infinity() : ends[i];
+        double lo = std::max(a, start);
+        double hi = std::min(b, end);
+        if (hi > lo) {
+            total += (squared ? vals[i] * vals[i] : vals[i]) * (hi - lo);
+        }
+        start = end;
+    }
+    return total;
+}
+
+/**
+ * \brief sigma(S) of one time step, interpolated in the surface row the step's parameters point at.
+ *
+ * The surface is copied to locals once per step so that the per-path lookup is plain arithmetic.
+ */
+struct Local_sigma {
+    explicit Local_sigma(const Parameters &p)
+            : row(p.local_vol_row), spot_min(p.local_vol->spot_min()), inv_step(1 / p.local_vol->spot_step()),
+              last(p.local_vol->num_spots() - 1) {}
+
+    double operator()(double S) const {
+        double x = std::min(std::max((S - spot_min) * inv_step, 0.0), static_cast<double>(last));
+        int j = std::min(static_cast<int>(x), last - 1);
+        double w = x - j;
+        return row[j] + w * (row[j + 1] - row[j]);
+    }
+
+    /** \brief      As above, also writing the slope dsigma/dS of the interpolated row at S to
+    *               dsigma_dS (zero where sigma is held flat, outside the spot nodes).
+    */
+    double operator()(double S, double &dsigma_dS) const {
+        double u = (S - spot_min) * inv_step;
+        double x = std::min(std::max(u, 0.0), static_cast<double>(last));
+        int j = std::min(static_cast<int>(x), last - 1);
+        double w = x - j;
+        dsigma_dS = u > 0 && u < last ? (row[j + 1] - row[j]) * inv_step : 0.0;
+        return row[j] + w * (row[j + 1] - row[j]);
+    }
+
+    const double *row;
+    double spot_min;
+    double inv_step;
+    int last;
+};
+
+} // namespace
 
 /** \brief 		Default constructor for class Simulation. This constructor first initializes
 *				the members of the class. The prices private member is a vector of valarrays.
@@ -18,21 +85,65 @@
 *   \param 		p - Reference to our parameters (strike, vol, time, etc.)
 *   \param      num_sims - The number of Monte Carlo simulations
 *   \param      num_ts - The number of time steps
+*   \param      observation_steps - The steps to keep, in 1..num_ts. When empty every step is kept.
 * 	\return		Default constructor never has a return type.
 *
 */
-Simulation::Simulation(Parameters &p, int num_sims, int num_ts) : num_timesteps{num_ts}, params{p}, N{num_sims},
-                                                                  delta_t{(params.T - params.t0) / num_timesteps} {
+Simulation::Simulation(Parameters &p, int num_sims, int num_ts, std::vector<int> observation_steps)
+        : Simulation{p, num_sims, num_ts, std::move(observation_steps), true} {}
 
-    /* Create space for (num_ts+1) points in time (valarrays), where each valarray has initial value params.S0
-     * (initial spot price). */
-    prices_.resize(num_ts + 1);
+/** \brief 		Protected constructor used by simulations which keep their paths somewhere other
+*				than the in-memory prices grid (e.g. Out_of_core). When allocate_grid is false
+*				only the parameters, number of paths and timestep are set up.
+*   \param 		p - Reference to our parameters (strike, vol, time, etc.)
+*   \param      num_sims - The number of Monte Carlo simulations
+*   \param      num_ts - The number of time steps
+*   \param      allocate_grid - Whether to allocate the N x (num_ts+1) prices grid
+*
+*/
+Simulation::Simulation(Parameters &p, int num_sims, int num_ts, bool allocate_grid)
+        : Simulation{p, num_sims, num_ts, {}, allocate_grid} {}
 
-    for (auto i = 0; i < num_ts + 1; ++i) {
-        prices_[i].resize(N);
+/** \brief 		Protected constructor behind the others. Sets up the parameters, number of paths,
+*				timestep and observed steps, and allocates the kept slices when allocate_grid is
+*				true (e.g. Lazy_simulation allocates its own as they are computed).
+*   \param 		p - Reference to our parameters (strike, vol, time, etc.)
+*   \param      num_sims - The number of Monte Carlo simulations
+*   \param      num_ts - The number of time steps
+*   \param      observation_steps - The steps to keep, in 1..num_ts. When empty every step is kept.
+*   \param      allocate_grid - Whether to allocate one N-length slice per kept step
+*
+*/
+Simulation::Simulation(Parameters &p, int num_sims, int num_ts, std::vector<int> observation_steps,
+                       bool allocate_grid)
+        : params{p}, N{num_sims}, delta_t{(params.T - params.t0) / num_ts}, num_timesteps_{num_ts} {
+
+    if (observation_steps.empty()) {
+        for (int n = 0; n <= num_ts; ++n) {
+            observed_.push_back(n);
+        }
+    } else {
+        std::sort(observation_steps.begin(), observation_steps.end());
+        observation_steps.erase(std::unique(observation_steps.begin(), observation_steps.end()),
+                                observation_steps.end());
+        if (observation_steps.front() < 1 || observation_steps.back() > num_ts) {
+            std::cerr << "Error. Observation steps must lie in 1.." << num_ts << "." << '\n';
+            exit(1);
+        }
+        observed_.assign(1, 0);
+        observed_.insert(observed_.end(), observation_steps.begin(), observation_steps.end());
+    }
+
+    if (!allocate_grid) {
+        return;
     }
 
+    /* Create space for the kept points in time (valarrays), where the first valarray has initial value params.S0
+     * (initial spot price). */
+    prices_.assign(observed_.size(), std::valarray<double>(N));
+
     prices_[0] = params.S0;
+    SDE_COUNT("bytes_allocated", static_cast<std::int64_t>(N) * observed_.size() * sizeof(double));
 }
 
 /** \brief 		This function inserts a valarray at a given timestep n. To do this, the
@@ -48,7 +159,7 @@ void Simulation::insert_valarray_at_step(std::valarray<double> vals, int n) {
 
 //    prices_.insert (prices_.begin()+n, vals);   // equivalent to prices_[n] = vals;
 
-    prices_[n] = vals;
+    prices_[slot(n)] = vals;
 
 }
 
@@ -63,10 +174,326 @@ void Simulation::insert_valarray_at_step(std::valarray<double> vals, int n) {
 std::valarray<double> &Simulation::get_valarray_at_step(int n) {
 
 //    return prices_.at (n);      // equivalent to return prices_[n];
-    return prices_[n];
+    return prices_[slot(n)];
+}
+
+/**  \brief     This function returns the simulated path i, i.e. the value of path i at every
+*               kept time step from t0 to T. The path is gathered from the time step valarrays.
+*   \param      i . The index of the requested path, 0 <= i < N.
+*   \return     valarray<double> . A valarray of observed_steps().size() doubles, num_timesteps+1
+*               when every step is kept.
+*
+*/
+std::valarray<double> Simulation::get_path(int i) {
+
+    std::valarray<double> path(observed_.size());
+
+    for (std::size_t k = 0; k < observed_.size(); ++k) {
+        path[k] = get_valarray_at_step(observed_[k])[i];
+    }
+
+    return path;
+}
+
+/**  \brief     Whether the prices of time step n are kept.
+*/
+bool Simulation::is_observed(int n) const {
+    return std::binary_search(observed_.begin(), observed_.end(), n);
+}
+
+/**  \brief     Moves T out by more_steps timesteps of the same length. When every step is
+*               kept the new steps are kept too, otherwise only the new terminal step is added to
+*               the schedule. Only the bookkeeping changes: simulations that support extension
+*               (e.g. Lazy_simulation) step the paths and store the new slices themselves.
+*   \param      more_steps . The number of timesteps to add, at least 1.
+*
+*/
+void Simulation::extend_horizon(int more_steps) {
+
+    if (more_steps < 1) {
+        std::cerr << "Error. The horizon can only be extended by at least one step." << '\n';
+        exit(1);
+    }
+
+    bool every_step = observed_.size() == static_cast<std::size_t>(num_timesteps_) + 1;
+    num_timesteps_ += more_steps;
+    params.T += more_steps * delta_t;
+
+    if (every_step) {
+        for (int n = num_timesteps_ - more_steps + 1; n <= num_timesteps_; ++n) {
+            observed_.push_back(n);
+        }
+    } else {
+        observed_.push_back(num_timesteps_);
+    }
+}
+
+/**  \brief     The index of time step n in observed_steps(), and so in prices_. Asking for a step
+*               outside the observation schedule is an error.
+*/
+std::size_t Simulation::slot(int n) const {
+
+    if (observed_.size() == static_cast<std::size_t>(num_timesteps_) + 1) {
+        return n;
+    }
+
+    auto it = std::lower_bound(observed_.begin(), observed_.end(), n);
+    if (it == observed_.end() || *it != n) {
+        std::cerr << "Error. Time step " << n << " is not in the observation schedule." << '\n';
+        exit(1);
+    }
+    return it - observed_.begin();
+}
+
+/** \brief 		Steps every path from t0 to T with one scheme and keeps the observed steps. The
+*				paths are advanced in one rolling buffer, which is copied out at each observed
+*				step, so the steps in between are never stored. When not every step is kept
+*				the paths are stepped tile by tile instead, see simulate_tiles(), and with a
+*				scheduler block by block on its workers, see simulate_blocks().
+*   \param 		rng - Cursor over N x num_timesteps standard normal variates, N per step. It is
+*				left after the last variate used.
+*   \param      step - The one-step update of the scheme.
+*   \param      scheduler - The workers to step on, or nullptr for the calling thread.
+*
+*/
+void Simulation::simulate(Variate_cursor &rng, Step_function step, Scheduler *scheduler) {
+
+    Step_table table{params, num_timesteps_};                   //< Coefficients of every step
+    long variates = static_cast<long>(N) * num_timesteps_;
+
+    if (scheduler && rng.position() + variates <= rng.pool().size()) {
+        simulate_blocks(rng, step, table, *scheduler);
+        return;
+    }
+    if (observed_.size() < static_cast<std::size_t>(num_timesteps_) + 1 && rng.position() + variates <= rng.pool().size()) {
+        simulate_tiles(rng, step, table);
+        return;
+    }
+
+    std::valarray<double> prices(params.S0, N);
+    std::valarray<double> rans(N);
+    std::size_t next = 1;                                       //< Next element of prices_ to fill
+
+    for (int idx = 1; idx <= num_timesteps_; ++idx) {
+        rng.fill(&rans[0], N);
+        step(prices, rans, table[idx - 1], delta_t);
+        if (next < observed_.size() && observed_[next] == idx) {
+            prices_[next++] = prices;
+        }
+    }
+}
+
+/** \brief 		Steps the paths in tiles of paths_per_tile, each taken from t0 to T before the
+*				next. The prices and variates of a tile stay in L1/L2 across the steps, and only
+*				the observed slices are written back, so the untiled pass's full read and write
+*				of the N prices at every step is gone. Path i still gets variate k*N + i of
+*				step k, so the result is identical to the untiled pass.
+*   \param 		rng - Cursor over N x num_timesteps standard normal variates that do not wrap around.
+*   \param      step - The one-step update of the scheme.
+*   \param      table - The coefficients of every step.
+*
+*/
+void Simulation::simulate_tiles(Variate_cursor &rng, Step_function step, const Step_table &table) {
+
+    const double *variates = rng.pool().data() + rng.position();
+    std::valarray<double> prices(paths_per_tile);
+    std::valarray<double> rans(paths_per_tile);
+
+    for (int first = 0; first < N; first += paths_per_tile) {
+        int n = std::min(paths_per_tile, N - first);
+        if (static_cast<int>(prices.size()) != n) {             //< last tile may be short
+            prices.resize(n);
+            rans.resize(n);
+        }
+        prices = params.S0;
+        std::size_t next = 1;
+
+        for (int idx = 1; idx <= num_timesteps_; ++idx) {
+            const double *z = variates + static_cast<long>(idx - 1) * N + first;
+            std::copy(z, z + n, std::begin(rans));
+            step(prices, rans, table[idx - 1], delta_t);
+            if (next < observed_.size() && observed_[next] == idx) {
+                prices_[next++][std::slice(first, n, 1)] = prices;
+            }
+        }
+    }
+
+    rng.advance(static_cast<long>(N) * num_timesteps_);
+}
+
+/** \brief 		As simulate_tiles(), with Block_stream blocks of paths stepped as tasks on the
+*				scheduler's workers. The kept slices were zeroed by the constructing thread, so
+*				their pages sit on its NUMA node; they are first touched again on the workers
+*				block by block (first_touch_again()), and the block that writes a column of
+*				every slice is then likely to run on the node that holds it. Path i still gets
+*				variate k*N + i of step k, so the result is identical to the serial passes.
+*   \param 		rng - Cursor over N x num_timesteps standard normal variates that do not wrap around.
+*   \param      step - The one-step update of the scheme.
+*   \param      table - The coefficients of every step.
+*   \param      scheduler - The workers to step on.
+*
+*/
+void Simulation::simulate_blocks(Variate_cursor &rng, Step_function step, const Step_table &table,
+                                 Scheduler &scheduler) {
+
+    const double *variates = rng.pool().data() + rng.position();
+    for (auto &slice : prices_) {
+        first_touch_again(&slice[0], N, scheduler);
+    }
+
+    long num_blocks = (N + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+    scheduler.parallel_range(0, num_blocks, 1, [&](long first_block, long blocks) {
+        for (long b = first_block; b < first_block + blocks; ++b) {
+            int first = static_cast<int>(b * Block_stream::paths_per_block);
+            int n = std::min(Block_stream::paths_per_block, N - first);
+            std::valarray<double> prices(params.S0, n);
+            std::valarray<double> rans(n);
+            std::size_t next = 1;
+
+            prices_[0][std::slice(first, n, 1)] = prices;
+            for (int idx = 1; idx <= num_timesteps_; ++idx) {
+                const double *z = variates + static_cast<long>(idx - 1) * N + first;
+                std::copy(z, z + n, std::begin(rans));
+                step(prices, rans, table[idx - 1], delta_t);
+                if (next < observed_.size() && observed_[next] == idx) {
+                    prices_[next++][std::slice(first, n, 1)] = prices;
+                }
+            }
+        }
+    });
+
+    rng.advance(static_cast<long>(N) * num_timesteps_);
+}
+
+
+
+/* ----------------------------------- Coefficient tables ----------------------------------- */
+
+/** \brief 		Checks the surface: at least one time row and two spot nodes, increasing times.
+*   \param 		times - The times of the rows.
+*   \param      spot_min . spot_max . num_spots - The uniform spot grid.
+*   \param      vols - sigma at every (time, spot) node, times.size() x num_spots, row-major.
+*
+*/
+Local_vol::Local_vol(std::vector<double> times, double spot_min, double spot_max, int num_spots,
+                     std::vector<double> vols)
+        : times_(std::move(times)), spot_min_(spot_min), spot_step_((spot_max - spot_min) / (num_spots - 1)),
+          num_spots_(num_spots), vols_(std::move(vols)) {
+
+    if (times_.empty() || num_spots_ < 2 || spot_max <= spot_min ||
+        vols_.size() != times_.size() * static_cast<std::size_t>(num_spots_) ||
+        !std::is_sorted(times_.begin(), times_.end())) {
+        std::cerr << "Error. A local volatility surface needs increasing times, at least two spot nodes and "
+                  << "times x spots volatilities." << '\n';
+        exit(1);
+    }
+}
+
+/** \brief 		The volatilities at the spot nodes at time t, interpolated linearly between the
+*				time rows and flat before the first and after the last.
+*/
+std::vector<double> Local_vol::row(double t) const {
+
+    auto upper = std::upper_bound(times_.begin(), times_.end(), t);
+    std::size_t hi = std::min<std::size_t>(upper - times_.begin(), times_.size() - 1);
+    std::size_t lo = upper == times_.begin() ? 0 : (upper - times_.begin()) - 1;
+    double w = hi == lo ? 0.0 : (t - times_[lo]) / (times_[hi] - times_[lo]);
+
+    std::vector<double> out(num_spots_);
+    for (int j = 0; j < num_spots_; ++j) {
+        out[j] = (1 - w) * vols_[lo * num_spots_ + j] + w * vols_[hi * num_spots_ + j];
+    }
+    return out;
+}
+
+/** \brief 		An exact description of the parameters, for keying checkpoints and cached
+*				results: every field, the term structure and the local volatility surface
+*				included. Doubles are written in hexadecimal floating point, so the description
+*				changes whenever one bit of a parameter does.
+*   \param 		p - Reference to our parameters.
+*   \return		std::string . One line of text.
+*
+*/
+std::string parameters_key(const Parameters &p) {
+
+    std::stringstream ss;
+    auto list = [&ss](const char *name, const std::vector<double> &values) {
+        ss << ' ' << name << '[';
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            ss << (i ? "," : "") << values[i];
+        }
+        ss << ']';
+    };
+
+    ss << std::hexfloat << "t0=" << p.t0 << " T=" << p.T << " S0=" << p.S0 << " sigma=" << p.sigma << " mu=" << p.mu;
+    list("term_times", p.term_times);
+    list("term_mu", p.term_mu);
+    list("term_sigma", p.term_sigma);
+
+    if (p.local_vol) {
+        list("local_vol_times", p.local_vol->times());
+        ss << " spot_min=" << p.local_vol->spot_min() << " spot_step=" << p.local_vol->spot_step()
+           << " num_spots=" << p.local_vol->num_spots();
+        list("vols", p.local_vol->vols());
+    }
+    return ss.str();
 }
 
+/** \brief 		The parameters of the interval [a, b], without the term structure: mu is the
+*				average of mu(t) and sigma the root mean square of sigma(t) over it, so one exact
+*				step of length b - a has the exact law of the interval.
+*   \param 		p - Reference to our parameters, with or without term structure.
+*   \param      a . b - The interval, a < b.
+*   \return		Parameters . A copy of p with constant coefficients.
+*
+*/
+Parameters interval_parameters(const Parameters &p, double a, double b) {
+
+    if (p.term_mu.size() != p.term_times.size() || p.term_sigma.size() != p.term_times.size() ||
+        !std::is_sorted(p.term_times.begin(), p.term_times.end())) {
+        std::cerr << "Error. term_times, term_mu and term_sigma must have the same length, with increasing times."
+                  << '\n';
+        exit(1);
+    }
+
+    Parameters s = p;
+    s.term_times.clear();
+    s.term_mu.clear();
+    s.term_sigma.clear();
 
+    if (!p.term_times.empty()) {
+        s.mu = integrate_piecewise(p.term_times, p.term_mu, a, b, false) / (b - a);
+        s.sigma = std::sqrt(integrate_piecewise(p.term_times, p.term_sigma, a, b, true) / (b - a));
+    }
+    return s;
+}
+
+/** \brief 		Computes the coefficients of every time step once: the average mu and the root
+*				mean square sigma of each step from the term structure, and the local volatility
+*				row at the start of each step.
+*   \param 		p - Reference to our parameters, with or without term structure.
+*   \param      num_ts - The number of time steps
+*
+*/
+Step_table::Step_table(const Parameters &p, int num_ts)
+        : steps_(num_ts), rows_(p.local_vol ? num_ts : 0) {
+
+    double delta_t = (p.T - p.t0) / num_ts;
+    double integrated_mu = 0;
+
+    for (int k = 0; k < num_ts; ++k) {
+        double a = p.t0 + k * delta_t;
+        Parameters &s = steps_[k] = interval_parameters(p, a, a + delta_t);
+
+        if (p.local_vol) {
+            rows_[k] = p.local_vol->row(a);
+            s.local_vol_row = rows_[k].data();
+        }
+        integrated_mu += s.mu * delta_t;
+    }
+
+    discount_factor_ = std::exp(-integrated_mu);
+}
 
 /* ----------------------------------- Euler-Maruyama method ----------------------------------- */
 
@@ -74,26 +501,66 @@ std::valarray<double> &Simulation::get_valarray_at_step(int n) {
 *				Maruyama scheme follow eq. 5. 
 *   \param 		p . N . ts . rng . p is a reference to a Parameters structure. N is the number
 *				of simulation paths and ts is the number of steps between t0 and T. rng is a 
-*				reference to an object of type Gaussan_RNs which contains N x ts random variates
-*				from the standard normal distribution.
+*				cursor over a pool of Gaussian variates, of which the N x ts from its position
+*				on are used.
+*   \param      observation_steps - The steps to keep, every step when empty.
+*   \param      scheduler - When given, the paths are stepped in blocks on its workers, see
+*				simulate_blocks().
 */
-Euler_Maruyama::Euler_Maruyama(Parameters &p, int N, int ts, const Gaussian_RNs &rng)
-        : Simulation{p, N, ts} {
+Euler_Maruyama::Euler_Maruyama(Parameters &p, int N, int ts, Variate_cursor rng,
+                               std::vector<int> observation_steps, Scheduler *scheduler)
+        : Simulation{p, N, ts, std::move(observation_steps)} {
 
     std::cout << "Constructor for Euler-Maruyama scheme constructing." << '\n';
-    int prev_idx{0};
+    SDE_PHASE("scheme.euler_maruyama", static_cast<std::int64_t>(N) * ts);
+    simulate(rng, step, scheduler);
+}
+
+/** \brief 		As above, reading the variates through rng's shared cursor, which is advanced past
+*				the N x ts variates used as if they had been drawn one by one.
+*/
+Euler_Maruyama::Euler_Maruyama(Parameters &p, int N, int ts, const Gaussian_RNs &rng,
+                               std::vector<int> observation_steps)
+        : Euler_Maruyama{p, N, ts, rng.cursor(rng.position()), std::move(observation_steps)} {
+    rng.advance(static_cast<long>(N) * ts);
+}
+
+/** \brief 		One Euler-Maruyama step (eq. 5) applied in place to a set of paths.
+*   \param 		prices . rans . p . delta_t . prices holds the path values at the current step
+*				and is overwritten with the values at the next step. rans holds one standard
+*				normal variate per path and is used as scratch space.
+*/
+void Euler_Maruyama::step(std::valarray<double> &prices, std::valarray<double> &rans, const Parameters &p,
+                          double delta_t) {
+
     double root_delta_t{std::sqrt(delta_t)};
-    std::valarray<double> rans(N);
-    double deterministic = 1 + (params.mu * delta_t);
+    double deterministic = 1 + (p.mu * delta_t);
 
-    for (int idx = 1; idx <= num_timesteps; ++idx) {
-        std::generate(std::begin(rans), std::end(rans), rng);
-        rans *= (root_delta_t * params.sigma);
-        rans += deterministic;
-        insert_valarray_at_step(get_valarray_at_step(prev_idx) * rans, idx);
-        prev_idx = idx;
+    if (p.local_vol_row) {
+        Local_sigma sigma{p};
+        for (std::size_t i = 0; i < prices.size(); ++i) {
+            prices[i] *= deterministic + sigma(prices[i]) * root_delta_t * rans[i];
+        }
+        return;
     }
 
+    rans *= (root_delta_t * p.sigma);
+    rans += deterministic;
+    prices *= rans;
+}
+
+/** \brief 		Differentiates one Euler-Maruyama step with respect to sigma:
+*				dS'/dsigma = dS/dsigma * (1 + mu*dt + sigma*sqrt(dt)*z) + S*sqrt(dt)*z.
+*   \param 		prices . tangent . rans . p . delta_t . prices and rans are the values at the
+*				start of the step. tangent holds dS/dsigma and is overwritten with its next value.
+*/
+void Euler_Maruyama::sigma_tangent(const std::valarray<double> &prices, std::valarray<double> &tangent,
+                                   const std::valarray<double> &rans, const Parameters &p, double delta_t) {
+
+    double root_delta_t{std::sqrt(delta_t)};
+
+    tangent *= 1 + (p.mu * delta_t) + (root_delta_t * p.sigma) * rans;
+    tangent += prices * rans * root_delta_t;
 }
 
 /* ----------------------------------- Exact method method ----------------------------------- */
@@ -102,31 +569,70 @@ Euler_Maruyama::Euler_Maruyama(Parameters &p, int N, int ts, const Gaussian_RNs
 *				scheme follow Eq. 7. 
 *   \param 		p . N . ts . rng . p is a reference to a Parameters structure. N is the number
 *				of simulation paths and ts is the number of steps between t0 and T. rng is a 
-*				reference to an object of type Gaussan_RNs which contains N x ts random variates
-*				from the standard normal distribution.
+*				cursor over a pool of Gaussian variates, of which the N x ts from its position
+*				on are used.
+*   \param      observation_steps - The steps to keep, every step when empty.
+*   \param      scheduler - When given, the paths are stepped in blocks on its workers, see
+*				simulate_blocks().
 */
-Exact_path::Exact_path(Parameters &p, int N, int ts, const Gaussian_RNs &rng)
-        : Simulation{p, N, ts} {
+Exact_path::Exact_path(Parameters &p, int N, int ts, Variate_cursor rng, std::vector<int> observation_steps,
+                       Scheduler *scheduler)
+        : Simulation{p, N, ts, std::move(observation_steps)} {
 
     std::cout << "Exact_path constructor constructing.\n";
-    int prev_idx{0};                                            //< Initialize previous index id
+    SDE_PHASE("scheme.exact", static_cast<std::int64_t>(N) * ts);
+    simulate(rng, step, scheduler);
+}
+
+/** \brief 		As above, reading the variates through rng's shared cursor, which is advanced past
+*				the N x ts variates used as if they had been drawn one by one.
+*/
+Exact_path::Exact_path(Parameters &p, int N, int ts, const Gaussian_RNs &rng, std::vector<int> observation_steps)
+        : Exact_path{p, N, ts, rng.cursor(rng.position()), std::move(observation_steps)} {
+    rng.advance(static_cast<long>(N) * ts);
+}
+
+/** \brief 		One exact GBM step (eq. 7) applied in place to a set of paths.
+*   \param 		prices . rans . p . delta_t . prices holds the path values at the current step
+*				and is overwritten with the values at the next step. rans holds one standard
+*				normal variate per path and is used as scratch space.
+*/
+void Exact_path::step(std::valarray<double> &prices, std::valarray<double> &rans, const Parameters &p,
+                      double delta_t) {
+
     double root_delta_t{std::sqrt(delta_t)};                    //< Square root of delta_t
-    std::valarray<double> rans(N);                              //< Initialize valarray of size N (# simulations)
-    double deterministic = (params.mu -
-                            0.5 * params.sigma * params.sigma) *
+    double deterministic = (p.mu -
+                            0.5 * p.sigma * p.sigma) *
                            delta_t;                             //< Deterministic part of exponential
 
-    for (int idx = 1; idx <= num_timesteps; ++idx) {
+    if (p.local_vol_row) {                                      //< log-Euler with sigma(t_k, S) over the step
+        Local_sigma sigma{p};
+        for (std::size_t i = 0; i < prices.size(); ++i) {
+            double s = sigma(prices[i]);
+            prices[i] *= std::exp((p.mu - 0.5 * s * s) * delta_t + s * root_delta_t * rans[i]);
+        }
+        return;
+    }
+
+    rans *= root_delta_t * p.sigma;                             //< lhs now z * root_delta_t * sigma
+    rans += deterministic;                                      //< lhs now z*root_delta_t * sigma + deterministic
+    rans = std::exp(rans);                                      //< lhs now all raised to exponential
+    prices *= rans;
+}
 
-        std::generate(std::begin(rans), std::end(rans), rng);     //< lhs is now z (Gaussian variates)
-        rans *= root_delta_t * params.sigma;                            //< lhs now z * root_delta_t * sigma
-        rans += deterministic;                                          //< lhs now z*root_delta_t * sigma + deterministic
-        rans = std::exp(rans);                                          //< lhs now all raised to exponential
+/** \brief 		Differentiates one exact step with respect to sigma:
+*				dS'/dsigma = g * (dS/dsigma + S*(sqrt(dt)*z - sigma*dt)), where g = S'/S.
+*   \param 		prices . tangent . rans . p . delta_t . prices and rans are the values at the
+*				start of the step. tangent holds dS/dsigma and is overwritten with its next value.
+*/
+void Exact_path::sigma_tangent(const std::valarray<double> &prices, std::valarray<double> &tangent,
+                               const std::valarray<double> &rans, const Parameters &p, double delta_t) {
 
-        // At t=0, the path is just S0. So we input our simulation path at t=1
-        insert_valarray_at_step(get_valarray_at_step(prev_idx) * rans, idx);    //< insert S0*everything_else at t=1.
-        prev_idx = idx;     //< prev_idx = 1
-    }
+    double root_delta_t{std::sqrt(delta_t)};
+    double deterministic = (p.mu - 0.5 * p.sigma * p.sigma) * delta_t;
+
+    tangent += prices * (rans * root_delta_t - p.sigma * delta_t);
+    tangent *= std::exp(rans * (root_delta_t * p.sigma) + deterministic);
 }
 
 /* ----------------------------------- Milstein method ----------------------------------- */
@@ -135,27 +641,128 @@ Exact_path::Exact_path(Parameters &p, int N, int ts, const Gaussian_RNs &rng)
 *				scheme follow Eq. 6. 
 *   \param 		p . N . ts . rng . p is a reference to a Parameters structure. N is the number
 *				of simulation paths and ts is the number of steps between t0 and T. rng is a 
-*				reference to an object of type Gaussan_RNs which contains N x ts random variates
-*				from the standard normal distribution. 
+*				cursor over a pool of Gaussian variates, of which the N x ts from its position
+*				on are used.
+*   \param      observation_steps - The steps to keep, every step when empty.
+*   \param      scheduler - When given, the paths are stepped in blocks on its workers, see
+*				simulate_blocks().
 * 	\return		Default constructor never has a return type.
 *
 */
-Milstein::Milstein(Parameters &p, int N, int ts, const Gaussian_RNs &rng)
-        : Simulation{p, N, ts} {
+Milstein::Milstein(Parameters &p, int N, int ts, Variate_cursor rng, std::vector<int> observation_steps,
+                   Scheduler *scheduler)
+        : Simulation{p, N, ts, std::move(observation_steps)} {
 
     std::cout << "Constructor for Milstein scheme constructing." << '\n';
+    SDE_PHASE("scheme.milstein", static_cast<std::int64_t>(N) * ts);
+    simulate(rng, step, scheduler);
+}
+
+/** \brief 		As above, reading the variates through rng's shared cursor, which is advanced past
+*				the N x ts variates used as if they had been drawn one by one.
+*/
+Milstein::Milstein(Parameters &p, int N, int ts, const Gaussian_RNs &rng, std::vector<int> observation_steps)
+        : Milstein{p, N, ts, rng.cursor(rng.position()), std::move(observation_steps)} {
+    rng.advance(static_cast<long>(N) * ts);
+}
+
+/** \brief 		One Milstein step (eq. 6) applied in place to a set of paths. Under a local
+*				volatility surface the diffusion is b(S) = sigma(t_k, S)*S, and the correction
+*				0.5*b*b'*dt*(z^2 - 1) includes the slope of sigma in S.
+*   \param 		prices . rans . p . delta_t . prices holds the path values at the current step
+*				and is overwritten with the values at the next step. rans holds one standard
+*				normal variate per path and is used as scratch space.
+*/
+void Milstein::step(std::valarray<double> &prices, std::valarray<double> &rans, const Parameters &p,
+                    double delta_t) {
 
-    int prev_idx{0};
     double root_delta_t{std::sqrt(delta_t)};
-    std::valarray<double> rans(N);
-    double sigma_component = 0.5 * (params.sigma * params.sigma);
+    double sigma_component = 0.5 * (p.sigma * p.sigma);
 
-    for (int idx = 1; idx <= num_timesteps; ++idx) {
-        std::generate(std::begin(rans), std::end(rans), rng);
-        rans *= ((params.sigma * root_delta_t) + (rans * sigma_component * delta_t));
-        rans += 1 + delta_t * (params.mu - sigma_component);
-        insert_valarray_at_step(get_valarray_at_step(prev_idx) * rans, idx);
-        prev_idx = idx;
+    if (p.local_vol_row) {                                      //< b(S) = sigma(t_k, S)*S, so b*b' = s*S*(s + S*ds/dS)
+        Local_sigma sigma{p};
+        for (std::size_t i = 0; i < prices.size(); ++i) {
+            double ds_dS;
+            double s = sigma(prices[i], ds_dS);
+            double z = rans[i];
+            prices[i] *= 1 + delta_t * p.mu + s * root_delta_t * z +
+                         0.5 * s * (s + prices[i] * ds_dS) * delta_t * (z * z - 1);
+        }
+        return;
     }
+
+    rans *= ((p.sigma * root_delta_t) + (rans * sigma_component * delta_t));
+    rans += 1 + delta_t * (p.mu - sigma_component);
+    prices *= rans;
 }
 
+/** \brief 		Differentiates one Milstein step with respect to sigma:
+*				dS'/dsigma = dS/dsigma * g + S*(sqrt(dt)*z + sigma*dt*(z^2 - 1)), where g = S'/S.
+*   \param 		prices . tangent . rans . p . delta_t . prices and rans are the values at the
+*				start of the step. tangent holds dS/dsigma and is overwritten with its next value.
+*/
+void Milstein::sigma_tangent(const std::valarray<double> &prices, std::valarray<double> &tangent,
+                             const std::valarray<double> &rans, const Parameters &p, double delta_t) {
+
+    double root_delta_t{std::sqrt(delta_t)};
+    double sigma_component = 0.5 * (p.sigma * p.sigma);
+    std::valarray<double> z2m1 = rans * rans - 1.0;
+
+    tangent *= 1 + (p.mu * delta_t) + (p.sigma * root_delta_t) * rans + (sigma_component * delta_t) * z2m1;
+    tangent += prices * (rans * root_delta_t + (p.sigma * delta_t) * z2m1);
+}
+
+/* ----------------------------------- Scheme lookup ----------------------------------- */
+
+/** \brief 		Looks up the one-step update of a scheme by name: "exact", "milstein" or
+*				"euler_maruyama".
+*   \param 		name - The scheme name.
+*   \return		Step_function . The scheme's step(), or nullptr if the name is unknown.
+*/
+Step_function scheme_step(const std::string &name) {
+
+    if (name == "exact") {
+        return Exact_path::step;
+    }
+    if (name == "milstein") {
+        return Milstein::step;
+    }
+    if (name == "euler_maruyama") {
+        return Euler_Maruyama::step;
+    }
+    return nullptr;
+}
+
+/** \brief 		The name of a scheme's one-step update, the inverse of scheme_step(). Any other
+*				step function is an error.
+*   \param 		step - The scheme's step().
+*   \return		std::string . "exact", "milstein" or "euler_maruyama".
+*/
+std::string scheme_name(Step_function step) {
+
+    for (const char *name : {"exact", "milstein", "euler_maruyama"}) {
+        if (step == scheme_step(name)) {
+            return name;
+        }
+    }
+    std::cerr << "Error. The step function is not one of the named schemes." << '\n';
+    exit(1);
+}
+
+/** \brief 		Looks up the sigma tangent of a scheme by name, as scheme_step().
+*   \param 		name - The scheme name.
+*   \return		Tangent_function . The scheme's sigma_tangent(), or nullptr if the name is unknown.
+*/
+Tangent_function scheme_sigma_tangent(const std::string &name) {
+
+    if (name == "exact") {
+        return Exact_path::sigma_tangent;
+    }
+    if (name == "milstein") {
+        return Milstein::sigma_tangent;
+    }
+    if (name == "euler_maruyama") {
+        return Euler_Maruyama::sigma_tangent;
+    }
+    return nullptr;
+}
@@ -8,9 +8,44 @@
 #include <cmath>
 #include <valarray>
 #include <iostream>
+#include <string>
+#include <memory>
 
 #include "myrandom.h"
 
+class Scheduler;
+
+/**
+ * \brief A local volatility surface sigma(t, S) on a grid of times and a uniform grid of spots.
+ *
+ * Rows are interpolated linearly in time (flat outside the grid) once per time step. Within a step sigma
+ * is interpolated linearly in S between the spot nodes and held flat outside them. The spot grid is
+ * uniform, so the lookup of each path is arithmetic rather than a search.
+ */
+class Local_vol {
+public:
+    Local_vol(std::vector<double> times, double spot_min, double spot_max, int num_spots, std::vector<double> vols);
+
+    std::vector<double> row(double t) const;
+
+    const std::vector<double> &times() const { return times_; }
+
+    const std::vector<double> &vols() const { return vols_; }
+
+    double spot_min() const { return spot_min_; }
+
+    double spot_step() const { return spot_step_; }
+
+    int num_spots() const { return num_spots_; }
+
+private:
+    std::vector<double> times_;
+    double spot_min_;
+    double spot_step_;
+    int num_spots_;
+    std::vector<double> vols_;      //!< times.size() x num_spots, row-major
+};
+
 /**
  * \brief Structure to hold parameters for the model to be simulated
  *
@@ -23,39 +58,140 @@ struct Parameters {
     double S0 = 100;        //!< Initial Value/price
     double sigma = 0.2;        //!< Volatility
     double mu = 0.05;        //!< Drift
+
+    // Optional term structure: piece i of mu(t) and sigma(t) ends at term_times[i], the last piece also
+    // covers everything after it. When empty, mu and sigma above are constant.
+    std::vector<double> term_times;
+    std::vector<double> term_mu;
+    std::vector<double> term_sigma;
+
+    std::shared_ptr<const Local_vol> local_vol;     //!< If set, sigma(t, S) replaces sigma and term_sigma
+    const double *local_vol_row = nullptr;          //!< sigma at the spot nodes for one step, set by Step_table
+};
+
+/**
+ * \brief Signature shared by the one-step update of every scheme.
+ *
+ * Advances the prices of a set of paths by one timestep in place, given one standard normal
+ * variate per path. The variates are consumed as scratch space.
+ */
+using Step_function = void (*)(std::valarray<double> &prices, std::valarray<double> &rans,
+                               const Parameters &p, double delta_t);
+
+/**
+ * \brief Signature shared by the sigma tangent of every scheme.
+ *
+ * Advances dS/dsigma of a set of paths by one timestep in place, given the prices and the variates at the
+ * start of the step, i.e. before step() is applied to them. Used for pathwise vega.
+ */
+using Tangent_function = void (*)(const std::valarray<double> &prices, std::valarray<double> &tangent,
+                                  const std::valarray<double> &rans, const Parameters &p, double delta_t);
+
+Parameters interval_parameters(const Parameters &p, double a, double b);
+
+std::string parameters_key(const Parameters &p);
+
+/**
+ * \brief The coefficients of every time step, computed once per run.
+ *
+ * Entry k is a copy of the parameters, without the term structure, whose mu and sigma are the effective values
+ * over [t0 + k*delta_t, t0 + (k+1)*delta_t]: the average drift and the root mean square volatility. These make
+ * the exact scheme exact for piecewise mu(t) and sigma(t), and leave the step functions unchanged. With a
+ * local volatility surface, entry k also points at the surface row of t0 + k*delta_t.
+ */
+class Step_table {
+public:
+    Step_table(const Parameters &p, int num_ts);
+
+    Step_table(const Step_table &) = delete;
+
+    Step_table &operator=(const Step_table &) = delete;
+
+    Step_table(Step_table &&) = default;
+
+    Step_table &operator=(Step_table &&) = default;
+
+    const Parameters &operator[](int k) const { return steps_[k]; }
+
+    double discount_factor() const { return discount_factor_; }
+
+private:
+    std::vector<Parameters> steps_;
+    std::vector<std::vector<double>> rows_;     //!< Local volatility rows, pointed at by steps_
+    double discount_factor_;                    //!< exp(-integral of mu(t) from t0 to T)
 };
 
 /**
  * \brief Class to hold information related to a simulation
+ *
+ * By default the prices of every time step are kept. Given an observation schedule, only step 0 and the
+ * observed steps are kept: the steps in between are taken in a rolling buffer, so memory scales with the
+ * number of observation dates rather than with num_timesteps. get_valarray_at_step() and
+ * insert_valarray_at_step() then accept observed steps only, and get_path() returns the observed values.
+ * Such runs are stepped in tiles of paths_per_tile paths, each taken through every step while its
+ * prices and variates stay in cache.
  */
 class Simulation {
 public:
-    Simulation(Parameters &params, int num_sims, int num_ts);            //!< Constructor for Simulation Class
+    static constexpr int paths_per_tile = 1024;     //!< Paths stepped together when not every step is kept
+
+    Simulation(Parameters &params, int num_sims, int num_ts,
+               std::vector<int> observation_steps = {});                 //!< Constructor for Simulation Class
     virtual ~Simulation() {
         std::cout << "Simulation destructor" << std::endl;
     };
 
-    std::valarray<double> &get_valarray_at_step(int n);
+    virtual std::valarray<double> &get_valarray_at_step(int n);
+
+    virtual void insert_valarray_at_step(std::valarray<double> vals, int n);
 
-    void insert_valarray_at_step(std::valarray<double> vals, int n);
+    virtual std::valarray<double> get_path(int i);
 
-    const int num_timesteps; //!< Number of time-steps for the simulation
+    bool is_observed(int n) const;
+
+    const std::vector<int> &observed_steps() const { return observed_; }
+
+    int num_timesteps() const { return num_timesteps_; }
 
 protected:
+    Simulation(Parameters &params, int num_sims, int num_ts, bool allocate_grid);
+
+    Simulation(Parameters &params, int num_sims, int num_ts, std::vector<int> observation_steps, bool allocate_grid);
+
+    std::size_t slot(int n) const;
+
+    void extend_horizon(int more_steps);
+
+    void simulate(Variate_cursor &rng, Step_function step, Scheduler *scheduler = nullptr);
+
     Parameters params;
     int N;              //!< Number of simulated paths to generate
     double delta_t;     //!< timestep. i.e. (T-t0)/num_of_timesteps
 
 private:
+    void simulate_tiles(Variate_cursor &rng, Step_function step, const Step_table &table);
+
+    void simulate_blocks(Variate_cursor &rng, Step_function step, const Step_table &table, Scheduler &scheduler);
 
     std::vector<std::valarray<double>> prices_;    //!< 2-dimensional valarray. Each element in the vector holds a valarray of simulated values
+    std::vector<int> observed_;                     //!< Step held by each element of prices_, 0 first
+    int num_timesteps_;                             //!< Number of time-steps, only changed by extend_horizon()
 };
 
 /* ---------------------------------- Euler-Maruyama method ----------------------------------- */
 
 class Euler_Maruyama : public Simulation {
 public:
-    Euler_Maruyama(Parameters &p, int N, int ts, const Gaussian_RNs &rng);
+    Euler_Maruyama(Parameters &p, int N, int ts, const Gaussian_RNs &rng, std::vector<int> observation_steps = {});
+
+    Euler_Maruyama(Parameters &p, int N, int ts, Variate_cursor rng, std::vector<int> observation_steps = {},
+                   Scheduler *scheduler = nullptr);
+
+    static void step(std::valarray<double> &prices, std::valarray<double> &rans, const Parameters &p,
+                     double delta_t);
+
+    static void sigma_tangent(const std::valarray<double> &prices, std::valarray<double> &tangent,
+                              const std::valarray<double> &rans, const Parameters &p, double delta_t);
 
     ~Euler_Maruyama() {
         std::cout << "Euler-Maruyama destructor" << std::endl;
@@ -70,7 +206,16 @@ public:
  */
 class Exact_path : public Simulation {
 public:
-    Exact_path(Parameters &p, int N, int ts, const Gaussian_RNs &rng);
+    Exact_path(Parameters &p, int N, int ts, const Gaussian_RNs &rng, std::vector<int> observation_steps = {});
+
+    Exact_path(Parameters &p, int N, int ts, Variate_cursor rng, std::vector<int> observation_steps = {},
+               Scheduler *scheduler = nullptr);
+
+    static void step(std::valarray<double> &prices, std::valarray<double> &rans, const Parameters &p,
+                     double delta_t);
+
+    static void sigma_tangent(const std::valarray<double> &prices, std::valarray<double> &tangent,
+                              const std::valarray<double> &rans, const Parameters &p, double delta_t);
 
     ~Exact_path() {
         std::cout << "Exact_path destructor" << std::endl;
@@ -84,7 +229,16 @@ public:
  */
 class Milstein : public Simulation {
 public:
-    Milstein(Parameters &p, int N, int ts, const Gaussian_RNs &rng);
+    Milstein(Parameters &p, int N, int ts, const Gaussian_RNs &rng, std::vector<int> observation_steps = {});
+
+    Milstein(Parameters &p, int N, int ts, Variate_cursor rng, std::vector<int> observation_steps = {},
+             Scheduler *scheduler = nullptr);
+
+    static void step(std::valarray<double> &prices, std::valarray<double> &rans, const Parameters &p,
+                     double delta_t);
+
+    static void sigma_tangent(const std::valarray<double> &prices, std::valarray<double> &tangent,
+                              const std::valarray<double> &rans, const Parameters &p, double delta_t);
 
     ~Milstein() {
         std::cout << "Milstein destructor" << std::endl;
@@ -93,4 +247,10 @@ public:
 };
 
 
+Step_function scheme_step(const std::string &name);
+
+Tangent_function scheme_sigma_tangent(const std::string &name);
+
+std::string scheme_name(Step_function step);
+
 #endif /* end of include guard: SIMULATION_H_GV5LHPBM */
@@ -0,0 +1,241 @@
+#include <map>
+#include <tuple>
+#include <vector>
+#include <valarray>
+#include <string>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+
+#include "myrandom.h"
+#include "simulation.h"
+#include "empirical.h"
+#include "sweep.h"
+#include "scheduler.h"
+#include "instrument.h"
+
+namespace {
+
+/** \brief      Steps paths [first, first+count) of a scenario from t0 to T and writes their
+*               prices at T to terminal. Only the current time step is kept. With a pool, the
+*               variates of step k are read straight from it (N per step, step-major) and it is
+*               never modified. Without one, each block of paths draws its variates from the
+*               worker's Block_stream, seeked to (seed, block).
+*/
+void simulate_paths(const Scenario &s, const Step_table &table, const Gaussian_RNs *pool, Block_stream &stream,
+                    long first, long count, std::valarray<double> &terminal) {
+
+    SDE_PHASE("sweep.paths", count * s.num_timesteps);
+
+    Step_function step = scheme_step(s.scheme);
+    double delta_t = (s.params.T - s.params.t0) / s.num_timesteps;
+    int len = static_cast<int>(count);
+    std::valarray<double> prices(s.params.S0, len);
+    std::valarray<double> rans(len);
+
+    if (!pool) {
+        stream.seek(s.seed, first / Block_stream::paths_per_block);
+    }
+
+    for (int k = 0; k < s.num_timesteps; ++k) {
+        if (pool) {
+            const double *z = pool->data() + static_cast<std::size_t>(k) * s.num_sims + first;
+            std::copy(z, z + len, std::begin(rans));
+        } else {
+            stream.fill(&rans[0], len);
+        }
+        step(prices, rans, table[k], delta_t);
+    }
+
+    terminal[std::slice(first, len, 1)] = prices;
+}
+
+} // namespace
+
+/** \brief 		Reads a scenario list. Each line holds
+*				    name T sigma mu S0 num_sims num_timesteps seed [scheme]
+*				separated by whitespace, where scheme is exact (the default), milstein or
+*				euler_maruyama. Blank lines and lines starting with '#' are skipped.
+*   \param 		filename - The scenario file.
+*   \return		std::vector<Scenario> . The scenarios in file order.
+*
+*/
+std::vector<Scenario> read_scenarios(std::string filename) {
+
+    std::ifstream infile(filename);
+    if (!infile.is_open()) {
+        std::cerr << "Error opening scenario file " << filename << '\n';
+        exit(1);
+    }
+
+    std::vector<Scenario> scenarios;
+    std::string line;
+    int line_no = 0;
+
+    while (std::getline(infile, line)) {
+        ++line_no;
+        std::stringstream ss(line);
+        Scenario s;
+
+        if (!(ss >> s.name) || s.name[0] == '#') {
+            continue;
+        }
+
+        if (!(ss >> s.params.T >> s.params.sigma >> s.params.mu >> s.params.S0 >> s.num_sims >> s.num_timesteps
+                 >> s.seed)) {
+            std::cerr << "Error in " << filename << " line " << line_no
+                      << ": expected name T sigma mu S0 num_sims num_timesteps seed [scheme]" << '\n';
+            exit(1);
+        }
+        ss >> s.scheme;
+
+        if (!scheme_step(s.scheme) || s.num_sims <= 0 || s.num_timesteps <= 0) {
+            std::cerr << "Error in " << filename << " line " << line_no << ": invalid scheme or run size" << '\n';
+            exit(1);
+        }
+        scenarios.push_back(s);
+    }
+
+    return scenarios;
+}
+
+/** \brief 		Runs every scenario of a sweep on the scheduler's workers. Scenarios with the same
+*				(num_sims, num_timesteps, seed) share one pool of variates, generated once, so
+*				the sweep cost is dominated by stepping. Only the current time step of each
+*				scenario is held in memory. Pools and terminal prices are first touched by the
+*				workers block by block, so their pages sit on the nodes of the workers that read
+*				them rather than of the thread that allocated them.
+*
+*				Every scenario is split into blocks of paths, so a 10M path scenario spreads over
+*				all workers while small ones take one task each. The statistics of each block are
+*				merged in block order, so a scenario's result is bit identical whatever the number
+*				of workers and however the blocks were stolen. Scenarios whose pool would be
+*				larger than max_pool_bytes draw their variates block by block from per-worker
+*				Block_streams instead. Those are reproducible from (seed, block), so scenarios with
+*				the same (num_sims, num_timesteps, seed) still see the same variates.
+*
+*				With a cache, scenarios already run with the same number of bins and the same
+*				source of variates are answered from it, and only the others are simulated (and
+*				their pools generated). The results of those are stored in the cache.
+*   \param 		scenarios - The scenarios to run.
+*   \param      scheduler - The work-stealing scheduler to run on.
+*   \param      num_bins - The number of bins of each terminal histogram.
+*   \param      max_pool_bytes - The largest pool of variates to generate up front.
+*   \param      cache - The result cache, or nullptr.
+*   \return		std::vector<Scenario_result> . One result per scenario, in input order.
+*
+*/
+std::vector<Scenario_result> run_sweep(const std::vector<Scenario> &scenarios, Scheduler &scheduler, int num_bins,
+                                       std::size_t max_pool_bytes, Result_cache *cache) {
+
+    SDE_PHASE("sweep.total");
+
+    auto uses_pool = [&](const Scenario &s) {
+        return static_cast<std::size_t>(s.num_sims) * s.num_timesteps * sizeof(double) <= max_pool_bytes;
+    };
+    auto descriptor = [&](const Scenario &s) {
+        std::string variant = "sweep bins=" + std::to_string(num_bins) + (uses_pool(s) ? " pool" : " stream");
+        return Run_descriptor{s.scheme, s.params, s.num_sims, s.num_timesteps, s.seed, variant};
+    };
+
+    std::vector<Scenario_result> results(scenarios.size());
+    std::vector<bool> cached(scenarios.size(), false);
+    for (std::size_t i = 0; cache && i < scenarios.size(); ++i) {
+        if (std::shared_ptr<const Cached_result> hit = cache->lookup(descriptor(scenarios[i]))) {
+            results[i] = Scenario_result{scenarios[i], hit->stats.mean(), hit->stats.variance(), hit->hist};
+            cached[i] = true;
+        }
+    }
+
+    using Pool_key = std::tuple<int, int, std::uint64_t>;
+    std::map<Pool_key, int> pool_index;
+    std::vector<Pool_key> pool_keys;
+    std::vector<int> scenario_pool(scenarios.size());
+
+    for (std::size_t i = 0; i < scenarios.size(); ++i) {
+        const Scenario &s = scenarios[i];
+        if (cached[i]) {
+            continue;
+        }
+        Pool_key key{s.num_sims, s.num_timesteps, s.seed};
+        auto it = pool_index.find(key);
+        if (it == pool_index.end()) {
+            it = pool_index.emplace(key, static_cast<int>(pool_keys.size())).first;
+            pool_keys.push_back(key);
+        }
+        scenario_pool[i] = it->second;
+    }
+
+    std::vector<std::unique_ptr<Gaussian_RNs>> pools(pool_keys.size());
+    scheduler.parallel_for(static_cast<int>(pools.size()), [&](int i) {
+        const Pool_key &key = pool_keys[i];
+        std::size_t n = static_cast<std::size_t>(std::get<0>(key)) * std::get<1>(key);
+        if (n * sizeof(double) <= max_pool_bytes) {
+            pools[i] = std::make_unique<Gaussian_RNs>(static_cast<int>(n), std::get<2>(key), std::get<0>(key),
+                                                      scheduler);
+        }
+    });
+
+    Per_worker<Block_stream> streams(scheduler);
+
+    scheduler.parallel_for(static_cast<int>(scenarios.size()), [&](int i) {
+        if (cached[i]) {
+            return;
+        }
+        const Scenario &s = scenarios[i];
+        const Gaussian_RNs *pool = pools[scenario_pool[i]].get();
+        long num_blocks = (s.num_sims + Block_stream::paths_per_block - 1) / Block_stream::paths_per_block;
+        std::valarray<double> terminal(s.num_sims);
+        first_touch_again(&terminal[0], s.num_sims, scheduler);
+        std::vector<Running_stats> stats(num_blocks);
+        Step_table table{s.params, s.num_timesteps};
+
+        scheduler.parallel_range(0, num_blocks, 1, [&](long first_block, long blocks) {
+            for (long b = first_block; b < first_block + blocks; ++b) {
+                long first = b * Block_stream::paths_per_block;
+                long count = std::min<long>(Block_stream::paths_per_block, s.num_sims - first);
+                simulate_paths(s, table, pool, streams.local(), first, count, terminal);
+                stats[b].add(terminal[std::slice(first, count, 1)]);
+            }
+        });
+
+        Running_stats total;                                //< merged in block order, whatever ran where
+        for (const auto &st : stats) {
+            total.merge(st);
+        }
+        results[i] = Scenario_result{s, total.mean(), total.variance(), create_density_hist(terminal, num_bins)};
+        if (cache) {
+            cache->store(descriptor(s), Cached_result{total, results[i].hist,
+                                                      cache->keep_terminal() ? terminal : std::valarray<double>()});
+        }
+    });
+
+    return results;
+}
+
+/** \brief      Writes one row per scenario: its name, scheme and parameters followed by the
+*               mean and variance of the terminal prices.
+*/
+void write_sweep_to_file(const std::vector<Scenario_result> &results, std::string filename) {
+
+    std::cout << "Writing results to file: " << filename << '\n';
+
+    std::ofstream outfile;
+    outfile.open(filename);
+
+    if (!outfile.is_open()) {
+        std::cerr << "Error opening outfile." << '\n';
+        exit(1);
+    }
+
+    outfile << "# name\tscheme\tT\tsigma\tmu\tS0\tnum_sims\tnum_timesteps\tseed\tmean\tvariance\n";
+    for (const auto &r : results) {
+        const Scenario &s = r.scenario;
+        outfile << s.name << '\t' << s.scheme << '\t' << s.params.T << '\t' << s.params.sigma << '\t'
+                << s.params.mu << '\t' << s.params.S0 << '\t' << s.num_sims << '\t' << s.num_timesteps << '\t'
+                << s.seed << '\t' << r.mean << '\t' << r.variance << std::endl;
+    }
+}
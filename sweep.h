@@ -0,0 +1,43 @@
+#ifndef SWEEP_H_JZVCKRPO
+#define SWEEP_H_JZVCKRPO
+
+#include <map>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "simulation.h"
+#include "scheduler.h"
+#include "result_cache.h"
+
+/**
+ * \brief One scenario of a parameter sweep: the model parameters, the run size, the seed of its variates
+ *        and the scheme to step with.
+ */
+struct Scenario {
+    std::string name;
+    Parameters params;
+    int num_sims;
+    int num_timesteps;
+    std::uint64_t seed;
+    std::string scheme = "exact";      //!< "exact", "milstein" or "euler_maruyama"
+};
+
+/**
+ * \brief Terminal statistics and density histogram of one scenario.
+ */
+struct Scenario_result {
+    Scenario scenario;
+    double mean;
+    double variance;
+    std::map<double, double> hist;
+};
+
+std::vector<Scenario> read_scenarios(std::string filename);
+
+std::vector<Scenario_result> run_sweep(const std::vector<Scenario> &scenarios, Scheduler &scheduler, int num_bins = 100,
+                                       std::size_t max_pool_bytes = std::size_t{1} << 30, Result_cache *cache = nullptr);
+
+void write_sweep_to_file(const std::vector<Scenario_result> &results, std::string filename);
+
+#endif /* end of include guard: SWEEP_H_JZVCKRPO */